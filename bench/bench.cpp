@@ -0,0 +1,198 @@
+// dryfinder-bench: generate deterministic corpora for a set of scenarios
+// (including pathological ones), run the dryfinder binary on each with
+// --stats=json and report the median time per phase plus throughput.
+//
+//   dryfinder-bench /path/to/dryfinder [--scale X] [--repeat N]
+//                   [--only NAME] [--keep] [-- extra dryfinder args]
+#include "corpus.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+struct Scenario {
+    std::string name;
+    corpus::Spec spec;
+    size_t min_lines;
+};
+
+static std::vector<Scenario> scenarios(double scale) {
+    auto n = [scale](size_t v) { return std::max<size_t>(1, static_cast<size_t>(static_cast<double>(v) * scale)); };
+    std::vector<Scenario> out;
+    {
+        Scenario s{ "mixed", {}, 8 };
+        s.spec.files = n(400);
+        s.spec.lines = 500;
+        out.push_back(s);
+    }
+    {
+        Scenario s{ "high-dup", {}, 8 };
+        s.spec.files = n(200);
+        s.spec.lines = 500;
+        s.spec.dup_rate = 0.8;
+        s.spec.seed = 2;
+        out.push_back(s);
+    }
+    {
+        Scenario s{ "vendored", {}, 8 };
+        s.spec.files = n(400);
+        s.spec.lines = 500;
+        s.spec.vendored = 0.5;
+        s.spec.seed = 6;
+        out.push_back(s);
+    }
+    {
+        Scenario s{ "long-lines", {}, 6 };
+        s.spec.files = n(100);
+        s.spec.lines = 400;
+        s.spec.line_length = 300;
+        s.spec.seed = 3;
+        out.push_back(s);
+    }
+    {
+        Scenario s{ "identical-lines", {}, 8 };
+        s.spec.kind = corpus::Kind::IdenticalLines;
+        s.spec.lines = n(100000);
+        out.push_back(s);
+    }
+    {
+        Scenario s{ "periodic-table", {}, 8 };
+        s.spec.kind = corpus::Kind::IdenticalLines;
+        s.spec.lines = n(100000);
+        s.spec.period = 5;
+        s.spec.seed = 7;
+        out.push_back(s);
+    }
+    {
+        Scenario s{ "tiny-files", {}, 3 };
+        s.spec.kind = corpus::Kind::TinyFiles;
+        s.spec.files = n(20000);
+        s.spec.lines = 5;
+        s.spec.block_min = 3;
+        s.spec.block_max = 5;
+        s.spec.seed = 4;
+        out.push_back(s);
+    }
+    {
+        Scenario s{ "license-headers", {}, 8 };
+        s.spec.kind = corpus::Kind::LicenseHeaders;
+        s.spec.files = n(2000);
+        s.spec.lines = 60;
+        s.spec.header_lines = 40;
+        s.spec.dup_rate = 0.05;
+        s.spec.seed = 5;
+        out.push_back(s);
+    }
+    return out;
+}
+
+static std::string quote(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') out.push_back('\\');
+        out.push_back(c);
+    }
+    return out + "\"";
+}
+
+// Minimal lookup of a numeric field in the flat --stats=json output.
+static double json_number(const std::string& json, const std::string& key) {
+    size_t pos = json.find("\"" + key + "\":");
+    if (pos == std::string::npos) return 0.0;
+    return std::strtod(json.c_str() + pos + key.size() + 3, nullptr);
+}
+
+static const char* const kPhases[] = {
+    "glob", "sniff", "load", "seed", "extend", "aggregate", "sort", "emit", "other",
+};
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " DRYFINDER [--scale X] [--repeat N] [--only NAME] [--keep]"
+                  << " [-- extra args]\n";
+        return 2;
+    }
+    std::string exe = fs::absolute(argv[1]).string();
+    double scale = 1.0;
+    int repeat = 3;
+    std::string only;
+    bool keep = false;
+    std::string extra;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--scale" && i + 1 < argc) scale = std::stod(argv[++i]);
+        else if (arg == "--repeat" && i + 1 < argc) repeat = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--only" && i + 1 < argc) only = argv[++i];
+        else if (arg == "--keep") keep = true;
+        else if (arg == "--") {
+            for (++i; i < argc; ++i) extra += " " + quote(argv[i]);
+        } else {
+            std::cerr << "unknown argument: " << arg << "\n";
+            return 2;
+        }
+    }
+
+    fs::path work = fs::temp_directory_path() /
+        ("dryfinder-bench-" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+    fs::create_directories(work);
+    fs::path stats_file = work / "stats.json";
+#if defined(_WIN32)
+    const char* null_dev = "NUL";
+#else
+    const char* null_dev = "/dev/null";
+#endif
+
+    std::printf("%-16s %7s %9s %8s %9s %12s %9s   %s\n", "scenario", "files", "lines", "MB",
+                "median_s", "lines/s", "MB/s", "phases (median s)");
+    int failures = 0;
+    for (const auto& sc : scenarios(scale)) {
+        if (!only.empty() && sc.name != only) continue;
+        fs::path dir = work / sc.name;
+        corpus::Info info = corpus::generate(dir, sc.spec);
+
+        // Run from inside the corpus directory: globs are relative.
+        std::string cmd = "cd " + quote(dir.string()) + " && " + quote(exe) +
+                          " --stats=json --min-lines " + std::to_string(sc.min_lines) + extra +
+                          " \"**.c\" > " + null_dev + " 2> " + quote(stats_file.string());
+        std::vector<double> totals;
+        std::vector<std::vector<double>> phases(sizeof(kPhases) / sizeof(kPhases[0]));
+        for (int r = 0; r < repeat; ++r) {
+            if (std::system(cmd.c_str()) != 0) {
+                std::cerr << sc.name << ": dryfinder failed: " << cmd << "\n";
+                ++failures;
+                break;
+            }
+            std::ifstream in(stats_file);
+            std::stringstream ss;
+            ss << in.rdbuf();
+            std::string json = ss.str();
+            totals.push_back(json_number(json, "total_seconds"));
+            for (size_t p = 0; p < phases.size(); ++p) phases[p].push_back(json_number(json, kPhases[p]));
+        }
+        if (totals.empty()) continue;
+
+        auto median = [](std::vector<double> v) {
+            std::sort(v.begin(), v.end());
+            return v[v.size() / 2];
+        };
+        double t = median(totals);
+        double mb = static_cast<double>(info.bytes) / 1e6;
+        std::printf("%-16s %7zu %9zu %8.2f %9.4f %12.0f %9.2f  ", sc.name.c_str(), info.files, info.lines,
+                    mb, t, t > 0 ? static_cast<double>(info.lines) / t : 0.0, t > 0 ? mb / t : 0.0);
+        for (size_t p = 0; p < phases.size(); ++p) std::printf(" %s=%.4f", kPhases[p], median(phases[p]));
+        std::printf("\n");
+        std::fflush(stdout);
+        if (!keep) fs::remove_all(dir);
+    }
+    if (keep) std::printf("corpora kept in %s\n", work.string().c_str());
+    else fs::remove_all(work);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,201 @@
+// Deterministic synthetic corpus generator shared by the benchmark harness
+// and the corpus-gen tool. Uses its own PRNG so a given spec produces the
+// same bytes on every platform and standard library.
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace corpus {
+
+enum class Kind {
+    Mixed,          // random code-like lines with shared blocks mixed in
+    IdenticalLines, // one file repeating the same `period` lines over and over
+    TinyFiles,      // many files of a few lines each
+    LicenseHeaders, // every file starts with the same long header
+};
+
+struct Spec {
+    Kind kind = Kind::Mixed;
+    size_t files = 200;
+    size_t lines = 400;        // lines per file
+    size_t line_length = 40;   // approximate characters per line
+    double dup_rate = 0.2;     // fraction of lines coming from shared blocks
+    size_t block_min = 5;      // shared block length range (lines)
+    size_t block_max = 30;
+    size_t shared_blocks = 64; // size of the shared block pool
+    size_t header_lines = 40;  // LicenseHeaders only
+    size_t period = 1;         // IdenticalLines only: lines per repetition
+    double noise = 0.0;        // chance that a copied block line is perturbed
+    double vendored = 0.0;     // chance that a file is also written verbatim under vendor/
+    double comments = 0.0;     // chance that a random line ends in a "#" or "//" comment
+    double script = 0.0;       // chance that a file (or its vendored copy) is named .py, not .c
+    uint64_t seed = 1;
+};
+
+struct Info {
+    size_t files = 0;
+    size_t lines = 0;
+    size_t bytes = 0;
+};
+
+// splitmix64: tiny, fast and fully specified
+class Rng {
+public:
+    explicit Rng(uint64_t seed) : s_(seed) {}
+    uint64_t next() {
+        uint64_t z = (s_ += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+    size_t below(size_t n) { return n ? static_cast<size_t>(next() % n) : 0; }
+    size_t range(size_t lo, size_t hi) { return lo + below(hi - lo + 1); }
+    double unit() { return static_cast<double>(next() >> 11) * (1.0 / 9007199254740992.0); }
+
+private:
+    uint64_t s_;
+};
+
+inline std::string random_line(Rng& rng, size_t target_len) {
+    static const char* const words[] = {
+        "int", "auto", "return", "if", "for", "value", "count", "result", "buffer",
+        "index", "node", "item", "size", "offset", "data", "state", "next", "prev",
+        "config", "handle", "=", "+", "-", "*", "(", ")", "{", "}", ";", ",",
+    };
+    constexpr size_t nwords = sizeof(words) / sizeof(words[0]);
+    std::string line(rng.range(0, 3) * 4, ' ');
+    while (line.size() < target_len) {
+        if (rng.below(4) == 0) line += "v" + std::to_string(rng.below(100000));
+        else line += words[rng.below(nwords)];
+        line.push_back(' ');
+    }
+    line.pop_back();
+    return line;
+}
+
+// Perturb one line of a copied block the way real copies drift: different
+// indentation, trailing or doubled whitespace, a blank line, a renamed
+// identifier or literal.
+inline void perturb(Rng& rng, std::vector<std::string>& lines) {
+    std::string& l = lines.back();
+    switch (rng.below(5)) {
+    case 0: l.insert(0, rng.below(2) ? "\t" : "  "); break;
+    case 1: l += rng.below(2) ? "  " : "\t"; break;
+    case 2: {
+        size_t first = l.find_first_not_of(" \t");
+        size_t sp = first == std::string::npos ? first : l.find(' ', first);
+        if (sp != std::string::npos) l.insert(sp, " ");
+        break;
+    }
+    case 3: lines.push_back(rng.below(2) ? "" : "   "); break;
+    case 4: {
+        size_t v = l.find(" v");
+        if (v != std::string::npos) l.insert(v + 2, "9");
+        break;
+    }
+    }
+}
+
+inline std::vector<std::string> random_block(Rng& rng, size_t n, size_t line_length) {
+    std::vector<std::string> out;
+    out.reserve(n);
+    for (size_t i = 0; i < n; ++i) out.push_back(random_line(rng, line_length));
+    return out;
+}
+
+inline void write_file(const std::filesystem::path& p, const std::vector<std::string>& lines, Info& info) {
+    std::ofstream out(p, std::ios::binary);
+    for (const auto& l : lines) {
+        out << l << '\n';
+        info.bytes += l.size() + 1;
+    }
+    info.lines += lines.size();
+    info.files += 1;
+}
+
+inline std::string file_name(size_t i, const char* ext = ".c") {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "f%06zu%s", i, ext);
+    return buf;
+}
+
+// Writes the corpus into `dir` (created if needed; files in sub-directories
+// of 100 files each, so "**" globs exercise the recursive walk).
+inline Info generate(const std::filesystem::path& dir, const Spec& spec) {
+    namespace fs = std::filesystem;
+    Rng rng(spec.seed);
+    Info info;
+    fs::create_directories(dir);
+    auto path_for = [&](size_t i, const fs::path& base) {
+        fs::path sub = base / ("d" + std::to_string(i / 100));
+        fs::create_directories(sub);
+        // Comment syntax follows the extension in token mode, so a .py copy
+        // of a .c file has the same bytes but different units.
+        const bool py = spec.script > 0 && rng.unit() < spec.script;
+        return sub / file_name(i, py ? ".py" : ".c");
+    };
+    auto line = [&] {
+        std::string l = random_line(rng, spec.line_length);
+        if (spec.comments > 0 && rng.unit() < spec.comments) {
+            l += rng.below(2) ? " # " : " // ";
+            l += random_line(rng, spec.line_length / 2);
+        }
+        return l;
+    };
+
+    switch (spec.kind) {
+    case Kind::IdenticalLines: {
+        std::vector<std::string> unit = random_block(rng, spec.period ? spec.period : 1, spec.line_length);
+        std::vector<std::string> lines;
+        for (size_t i = 0; i < spec.lines; ++i) lines.push_back(unit[i % unit.size()]);
+        write_file(path_for(0, dir), lines, info);
+        if (spec.vendored > 0 && rng.unit() < spec.vendored) write_file(path_for(0, dir / "vendor"), lines, info);
+        break;
+    }
+    case Kind::TinyFiles:
+    case Kind::Mixed:
+    case Kind::LicenseHeaders: {
+        std::vector<std::vector<std::string>> pool;
+        for (size_t b = 0; b < spec.shared_blocks; ++b) {
+            std::vector<std::string> blk(rng.range(spec.block_min, spec.block_max));
+            for (auto& l : blk) l = line();
+            pool.push_back(std::move(blk));
+        }
+        std::vector<std::string> header;
+        if (spec.kind == Kind::LicenseHeaders) {
+            header = random_block(rng, spec.header_lines, spec.line_length);
+        }
+        // Each step inserts a shared block with probability p, otherwise one
+        // random line. With mean block length B, the expected fraction of
+        // shared lines is pB / (pB + 1 - p) = dup_rate.
+        double B = static_cast<double>(spec.block_min + spec.block_max) / 2.0;
+        double r = spec.dup_rate < 0.999 ? spec.dup_rate : 0.999;
+        double p = r / (B * (1.0 - r) + r);
+        for (size_t f = 0; f < spec.files; ++f) {
+            std::vector<std::string> lines = header;
+            while (lines.size() < spec.lines + header.size()) {
+                if (!pool.empty() && rng.unit() < p) {
+                    const auto& blk = pool[rng.below(pool.size())];
+                    for (const auto& bl : blk) {
+                        lines.push_back(bl);
+                        if (spec.noise > 0 && rng.unit() < spec.noise) perturb(rng, lines);
+                    }
+                } else {
+                    lines.push_back(line());
+                }
+            }
+            write_file(path_for(f, dir), lines, info);
+            if (spec.vendored > 0 && rng.unit() < spec.vendored) write_file(path_for(f, dir / "vendor"), lines, info);
+        }
+        break;
+    }
+    }
+    return info;
+}
+
+} // namespace corpus
@@ -0,0 +1,55 @@
+// dryfinder-corpus-gen: write a deterministic synthetic corpus to a
+// directory, e.g. to reproduce a benchmark scenario by hand.
+#include "corpus.hpp"
+
+#include <iostream>
+#include <string>
+
+static void usage_and_exit(const char* argv0) {
+    std::cerr << "Usage: " << argv0 << " OUTDIR [--kind mixed|identical-lines|tiny-files|license-headers]\n"
+              << "       [--files N] [--lines N] [--line-length N] [--dup-rate R]\n"
+              << "       [--block-min N] [--block-max N] [--header-lines N] [--period N] [--vendored R]\n"
+              << "       [--seed N]\n";
+    std::exit(2);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) usage_and_exit(argv[0]);
+    std::string out_dir;
+    corpus::Spec spec;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            auto value = [&]() -> std::string {
+                if (i + 1 >= argc) usage_and_exit(argv[0]);
+                return argv[++i];
+            };
+            if (arg == "--kind") {
+                std::string k = value();
+                if (k == "mixed") spec.kind = corpus::Kind::Mixed;
+                else if (k == "identical-lines") spec.kind = corpus::Kind::IdenticalLines;
+                else if (k == "tiny-files") spec.kind = corpus::Kind::TinyFiles;
+                else if (k == "license-headers") spec.kind = corpus::Kind::LicenseHeaders;
+                else usage_and_exit(argv[0]);
+            } else if (arg == "--files") spec.files = std::stoul(value());
+            else if (arg == "--lines") spec.lines = std::stoul(value());
+            else if (arg == "--line-length") spec.line_length = std::stoul(value());
+            else if (arg == "--dup-rate") spec.dup_rate = std::stod(value());
+            else if (arg == "--block-min") spec.block_min = std::stoul(value());
+            else if (arg == "--block-max") spec.block_max = std::stoul(value());
+            else if (arg == "--header-lines") spec.header_lines = std::stoul(value());
+            else if (arg == "--period") spec.period = std::stoul(value());
+            else if (arg == "--vendored") spec.vendored = std::stod(value());
+            else if (arg == "--seed") spec.seed = std::stoull(value());
+            else if (out_dir.empty() && arg.rfind("--", 0) != 0) out_dir = arg;
+            else usage_and_exit(argv[0]);
+        }
+    } catch (...) {
+        usage_and_exit(argv[0]);
+    }
+    if (out_dir.empty() || spec.block_min == 0 || spec.block_min > spec.block_max) usage_and_exit(argv[0]);
+
+    corpus::Info info = corpus::generate(out_dir, spec);
+    std::cout << "files: " << info.files << "\nlines: " << info.lines << "\nbytes: " << info.bytes << "\n";
+    return 0;
+}
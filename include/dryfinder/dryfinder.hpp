@@ -0,0 +1,259 @@
+// libdryfinder: find repeated blocks of lines (or tokens) across files.
+//
+// Typical use:
+//
+//   dryfinder::Corpus corpus(load_opts);
+//   corpus.add_files(dryfinder::expand_globs({"src/**.cpp"}));
+//   dryfinder::YamlWriter yaml(std::cout);
+//   corpus.visit_duplicates(match_opts, yaml);
+//
+// A Corpus keeps every file normalized and interned, so it can be queried
+// repeatedly (e.g. with different window sizes) without re-reading files,
+// and single documents -- including unsaved editor buffers passed with
+// add_buffer() -- can be replaced without rescanning the rest.
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace dryfinder {
+
+// Unit of matching: whole (normalized) lines, or lexer tokens.
+enum class Granularity { Lines, Tokens };
+
+// Matching core: the optimized seed-and-extend engine, or the simple
+// reference implementation used as a test oracle.
+enum class Engine { Seed, Reference };
+
+// How Corpus::add_globs() reads files: batched io_uring submissions when the
+// kernel supports them (Linux), otherwise blocking reads on the loader
+// threads.
+enum class Reader { Auto, Uring, Threads };
+
+// How files are turned into matching units. Fixed for the lifetime of a
+// Corpus.
+struct LoadOptions {
+    Granularity granularity = Granularity::Lines;
+    bool ignore_indent = false;       // strip leading spaces/tabs
+    bool ignore_trailing_ws = false;  // strip trailing spaces/tabs
+    bool collapse_ws = false;         // runs of spaces/tabs compare as one space
+    bool ignore_blank_lines = false;  // whitespace-only lines are skipped
+    bool normalize_identifiers = false; // identifiers/literals match any identifier/literal
+    size_t binary_sniff_bytes = 4096; // 0 disables binary sniffing
+    double binary_ratio = 0.30;       // control-byte ratio above which a file is binary
+};
+
+// What counts as a duplicate. Can differ between queries on one Corpus.
+struct MatchOptions {
+    Engine engine = Engine::Seed;
+    size_t min_lines = 0;             // window size in line mode
+    size_t min_tokens = 0;            // window size in token mode
+    size_t max_gap = 0;               // mismatched/inserted units allowed inside a block
+    size_t memory_limit = 0;          // seed table budget in bytes; over it, sort on disk (0: none)
+};
+
+// Everything the command-line tool configures.
+struct ScanOptions : LoadOptions, MatchOptions {
+    size_t max_occurrences = 0;       // hits listed per block in the report (0: all)
+};
+
+struct Hit {
+    std::string path;   // generic string
+    size_t start_line;  // 1-based inclusive
+    size_t end_line;    // 1-based inclusive
+};
+
+struct DuplicateBlock {
+    std::vector<std::string> lines; // the block lines (from first occurrence)
+    std::vector<Hit> hits;          // sorted by (path, start_line, end_line)
+    // A periodic run (the same units over and over, e.g. a generated table)
+    // is one block with a single hit over the whole run: `lines` shows one
+    // period of `period` units, repeated `repeats` whole times. 0 otherwise.
+    size_t period = 0;
+    size_t repeats = 0;
+};
+
+// Files whose bytes are identical, e.g. vendored copies.
+struct IdenticalFileSet {
+    size_t lines = 0;
+    std::vector<std::string> paths; // generic strings, sorted
+};
+
+// Receives the blocks of one query in report order: longest first, then
+// most occurrences, then by content.
+class ResultVisitor {
+public:
+    virtual ~ResultVisitor() = default;
+    virtual void begin(size_t block_count) { (void)block_count; }
+    virtual void block(const DuplicateBlock& b) = 0;
+    virtual void end() {}
+};
+
+// Writes the YAML report printed by the command-line tool. With
+// `max_hits`, blocks with more hits list only the first `max_hits` and
+// say how many were left out; `occurrences` still counts them all.
+class YamlWriter : public ResultVisitor {
+public:
+    explicit YamlWriter(std::ostream& out, size_t max_hits = 0) : out_(out), max_hits_(max_hits) {}
+    void begin(size_t block_count) override;
+    void block(const DuplicateBlock& b) override;
+    void end() override;
+
+    // Optional "identical_files:" section, written after the blocks.
+    void identical_files(const std::vector<IdenticalFileSet>& sets);
+
+private:
+    std::ostream& out_;
+    size_t max_hits_;
+    size_t written_ = 0;
+};
+
+// Deliver `blocks` (already in report order) to `visitor`.
+void visit_blocks(const std::vector<DuplicateBlock>& blocks, ResultVisitor& visitor);
+
+// Expand shell-style globs (*, ?, ** recursive) to regular files, without
+// duplicates, sorted by generic path.
+std::vector<std::filesystem::path> expand_globs(const std::vector<std::string>& patterns);
+
+// Combine the partial files of every shard of one scan into the blocks a
+// single scan reports, in report order. Throws std::runtime_error when a
+// shard is missing, duplicated or from a different scan.
+std::vector<DuplicateBlock> merge_shards(const std::vector<std::filesystem::path>& partials);
+
+class Index;
+
+// An in-memory document: `text` is read during add_buffers() only.
+struct Document {
+    std::string name;       // reported as the hit path
+    std::string_view text;
+};
+
+// Compiled glob patterns, for testing single paths (e.g. files reported by
+// a filesystem watcher) the way expand_globs() would.
+class GlobSet {
+public:
+    explicit GlobSet(const std::vector<std::string>& patterns);
+    ~GlobSet();
+    GlobSet(GlobSet&&) noexcept;
+    GlobSet& operator=(GlobSet&&) noexcept;
+
+    // Whether `path` lies under a pattern's base directory and matches it.
+    bool matches(const std::filesystem::path& path) const;
+    // The directory each pattern is rooted at.
+    std::vector<std::filesystem::path> base_dirs() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+// A set of loaded documents (files or in-memory buffers), each split into
+// normalized, interned units. Documents are keyed by name (the generic path
+// for files); adding a name again replaces that document.
+class Corpus {
+public:
+    explicit Corpus(const LoadOptions& opts = {});
+    ~Corpus();
+    Corpus(Corpus&&) noexcept;
+    Corpus& operator=(Corpus&&) noexcept;
+
+    const LoadOptions& options() const;
+
+    // Read and index one file. Binary files are skipped (returns false);
+    // unreadable files are indexed as empty.
+    bool add_file(const std::filesystem::path& path);
+    void add_files(const std::vector<std::filesystem::path>& paths);
+
+    // Expand `patterns` and load the matching files on `jobs` threads (0: one
+    // per hardware thread) while the directory walk is still running.
+    // Documents end up in path order, as with add_files(expand_globs(...)).
+    // Filesystem errors from the walk are rethrown after loading stops, as
+    // is a missing io_uring with Reader::Uring.
+    void add_globs(const std::vector<std::string>& patterns, unsigned jobs = 0, Reader reader = Reader::Auto);
+
+    // Index an in-memory buffer under `name` without touching the
+    // filesystem. The text is copied into the index; it only has to outlive
+    // the call. Returns false (and drops any previous `name`) if binary.
+    bool add_buffer(const std::string& name, std::string_view text);
+    void add_buffers(const std::vector<Document>& docs);
+
+    // Drop a document; returns false if `name` is not indexed.
+    bool remove(const std::string& name);
+    bool contains(const std::string& name) const;
+
+    size_t file_count() const;
+
+    // All repeated blocks in report order.
+    std::vector<DuplicateBlock> find_duplicates(const MatchOptions& opts) const;
+
+    // Same as find_duplicates, delivered to `visitor`.
+    void visit_duplicates(const MatchOptions& opts, ResultVisitor& visitor) const;
+
+    // Sets of byte-identical documents, ordered by first path. Documents
+    // without matching units are left out. The seed engine matches each set
+    // once and reports its hits in every copy.
+    std::vector<IdenticalFileSet> identical_files() const;
+
+    // Keep a seed table over windows of `window` units and update it as
+    // documents are added, replaced or removed, so find_duplicates_of() with
+    // that window only hashes the one document.
+    void keep_seed_index(size_t window);
+
+    // Blocks with at least one hit in document `name`, in report order.
+    std::vector<DuplicateBlock> find_duplicates_of(const std::string& name, const MatchOptions& opts) const;
+
+    // Snapshot the corpus as a seed index over windows of `window` units.
+    Index build_index(size_t window) const;
+
+    // One shard of a scan split over `count` processes that loaded the same
+    // files: extend only the seed groups that hash to `shard` and write the
+    // resulting blocks, keyed by normalized content, to `path` for
+    // merge_shards(). Needs the seed engine without max_gap. Throws
+    // std::runtime_error on failure.
+    void write_shard(const MatchOptions& opts, unsigned shard, unsigned count,
+                     const std::filesystem::path& path) const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+// A persisted seed index: the hash of every window of the corpus plus the
+// unit IDs needed to extend matches, but not the file text. Queries hash
+// only the windows of the queried documents and look them up, instead of
+// matching the whole corpus against itself.
+class Index {
+public:
+    Index();
+    ~Index();
+    Index(Index&&) noexcept;
+    Index& operator=(Index&&) noexcept;
+
+    const LoadOptions& options() const; // normalization used when building
+    size_t window() const;              // seed window in units
+    size_t file_count() const;
+
+    // Write/read the index file. Throw std::runtime_error on I/O errors or
+    // if the file is not a compatible index.
+    void save(const std::filesystem::path& path) const;
+    static Index load(const std::filesystem::path& path);
+
+    // Blocks of at least window() units that occur in one of `docs` and at
+    // least once more (in the index or in `docs`), maximally extended as in
+    // a full scan, in report order. Indexed files with the same name as a
+    // document are replaced by it. The content shown is taken from `docs`.
+    std::vector<DuplicateBlock> query(const std::vector<Document>& docs);
+    std::vector<DuplicateBlock> query_files(const std::vector<std::filesystem::path>& paths);
+
+private:
+    friend class Corpus;
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+} // namespace dryfinder
@@ -0,0 +1,323 @@
+// dryfinder serve. One request per connection: a single line, answered with
+// the YAML report (or "error: ..." and a newline), then the socket is
+// closed.
+//
+//   scan                  all blocks
+//   query PATH            blocks with a hit in the indexed file PATH
+//   check NAME LENGTH     followed by LENGTH bytes: blocks with a hit in that
+//                         text, as if it were saved as NAME (unsaved buffers);
+//                         LENGTH is at most 256 MiB
+//
+// Changed files are re-read through inotify; only they are re-normalized
+// and re-hashed in the live seed table.
+#include "serve.hpp"
+#include "diag.hpp"
+
+#include <iostream>
+
+#if defined(__linux__)
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <map>
+#include <set>
+#include <sstream>
+#include <unordered_map>
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+using namespace dryfinder;
+
+#if defined(__linux__)
+
+static volatile std::sig_atomic_t g_stop = 0;
+
+static void on_stop_signal(int) {
+    g_stop = 1;
+}
+
+// Largest buffer a check request may send; longer ones are refused before
+// anything is read, so one client cannot make the daemon allocate without
+// bound.
+static constexpr size_t kMaxCheckBytes = size_t{ 256 } << 20;
+static constexpr size_t kMaxRequestLine = 64 * 1024;
+
+static std::string key_of(const fs::path& p) {
+    return p.lexically_normal().generic_string();
+}
+
+class Server {
+public:
+    Server(const ScanOptions& opts, const std::vector<std::string>& patterns)
+        : opts_(opts), patterns_(patterns), globs_(patterns), corpus_(opts) {}
+
+    ~Server() {
+        if (listen_fd_ >= 0) {
+            ::close(listen_fd_);
+            ::unlink(socket_path_.c_str());
+        }
+        if (inotify_fd_ >= 0) ::close(inotify_fd_);
+    }
+
+    bool start(const fs::path& socket_path) {
+        const bool tokens = opts_.granularity == Granularity::Tokens;
+        corpus_.keep_seed_index(tokens ? opts_.min_tokens : opts_.min_lines);
+        for (const auto& p : expand_globs(patterns_)) load(p);
+
+        inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotify_fd_ < 0) {
+            std::cerr << "inotify_init1: " << std::strerror(errno) << "\n";
+            return false;
+        }
+        for (const auto& base : globs_.base_dirs()) watch_tree(base);
+
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        const std::string sp = socket_path.string();
+        if (sp.size() >= sizeof(addr.sun_path)) {
+            std::cerr << "Socket path too long: " << sp << "\n";
+            return false;
+        }
+        std::memcpy(addr.sun_path, sp.c_str(), sp.size() + 1);
+        struct stat st {};
+        if (::lstat(sp.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) ::unlink(sp.c_str()); // stale
+        listen_fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listen_fd_ < 0 || ::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            ::listen(listen_fd_, 16) != 0) {
+            std::cerr << "Cannot listen on " << sp << ": " << std::strerror(errno) << "\n";
+            if (listen_fd_ >= 0) ::close(listen_fd_);
+            listen_fd_ = -1;
+            return false;
+        }
+        socket_path_ = sp;
+        DLOG(LogSub::Cli, 1, "serving " << corpus_.file_count() << " files on " << sp);
+        log_flush();
+        return true;
+    }
+
+    void run() {
+        while (!g_stop) {
+            pollfd fds[2] = { { inotify_fd_, POLLIN, 0 }, { listen_fd_, POLLIN, 0 } };
+            if (::poll(fds, 2, -1) < 0) {
+                if (errno == EINTR) continue;
+                std::cerr << "poll: " << std::strerror(errno) << "\n";
+                return;
+            }
+            if (fds[0].revents & POLLIN) drain_events();
+            if (fds[1].revents & POLLIN) {
+                int client = ::accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+                if (client >= 0) {
+                    handle(client);
+                    ::close(client);
+                }
+            }
+            log_flush();
+        }
+    }
+
+private:
+    // ----- Index maintenance -----
+
+    void load(const fs::path& p) {
+        if (corpus_.add_file(p)) indexed_[key_of(p)] = p;
+        else indexed_.erase(key_of(p));
+    }
+
+    void unload(const std::string& key) {
+        corpus_.remove(key);
+        indexed_.erase(key);
+    }
+
+    void watch_tree(const fs::path& dir) {
+        std::error_code ec;
+        if (!fs::is_directory(dir, ec)) return;
+        add_watch(dir);
+        for (fs::recursive_directory_iterator it(dir, fs::directory_options::follow_directory_symlink |
+                                                          fs::directory_options::skip_permission_denied, ec), end;
+             !ec && it != end; it.increment(ec)) {
+            if (it->is_directory(ec)) add_watch(it->path());
+        }
+    }
+
+    void add_watch(const fs::path& dir) {
+        const uint32_t mask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO;
+        int wd = inotify_add_watch(inotify_fd_, dir.c_str(), mask);
+        if (wd < 0) {
+            DLOG(LogSub::Cli, 1, "cannot watch " << dir.generic_string() << ": " << std::strerror(errno));
+            return;
+        }
+        watches_[wd] = dir;
+    }
+
+    // Re-expand the globs and reconcile with the index; used when whole
+    // directories appear or disappear.
+    void resync() {
+        std::set<std::string> seen;
+        for (const auto& p : expand_globs(patterns_)) {
+            std::string key = key_of(p);
+            seen.insert(key);
+            if (!indexed_.count(key)) load(p);
+        }
+        for (auto it = indexed_.begin(); it != indexed_.end();) {
+            if (seen.count(it->first)) { ++it; continue; }
+            corpus_.remove(it->first);
+            it = indexed_.erase(it);
+        }
+    }
+
+    void drain_events() {
+        alignas(inotify_event) char buf[64 * 1024];
+        std::set<fs::path> changed;
+        bool dirs_changed = false;
+        while (true) {
+            ssize_t n = ::read(inotify_fd_, buf, sizeof(buf));
+            if (n <= 0) break;
+            for (char* p = buf; p < buf + n;) {
+                auto* ev = reinterpret_cast<inotify_event*>(p);
+                p += sizeof(inotify_event) + ev->len;
+                if (ev->mask & IN_IGNORED) {
+                    watches_.erase(ev->wd);
+                    continue;
+                }
+                auto w = watches_.find(ev->wd);
+                if (w == watches_.end() || ev->len == 0) continue;
+                fs::path path = w->second / ev->name;
+                if (ev->mask & IN_ISDIR) {
+                    if (ev->mask & (IN_CREATE | IN_MOVED_TO)) watch_tree(path);
+                    dirs_changed = true;
+                } else {
+                    changed.insert(path);
+                }
+            }
+        }
+        for (const auto& path : changed) {
+            std::error_code ec;
+            if (fs::is_regular_file(path, ec) && globs_.matches(path)) load(path);
+            else if (indexed_.count(key_of(path))) unload(key_of(path));
+            DLOG(LogSub::Load, 1, "reindexed " << path.generic_string());
+        }
+        if (dirs_changed) resync();
+    }
+
+    // ----- Requests -----
+
+    void handle(int fd) {
+        timeval tv{ 5, 0 };
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        std::string in;
+        size_t eol;
+        char chunk[4096];
+        while ((eol = in.find('\n')) == std::string::npos) {
+            if (in.size() > kMaxRequestLine) return reply(fd, "error: request line too long\n");
+            ssize_t n = ::read(fd, chunk, sizeof(chunk));
+            if (n <= 0) return;
+            in.append(chunk, static_cast<size_t>(n));
+        }
+        std::istringstream line(in.substr(0, eol));
+        std::string body = in.substr(eol + 1);
+        std::string cmd, name;
+        line >> cmd;
+        DLOG(LogSub::Cli, 1, "request: " << in.substr(0, eol));
+
+        // A failing request (e.g. out of memory) is answered; the server and
+        // its index stay up.
+        try {
+            std::vector<DuplicateBlock> blocks;
+            if (cmd == "scan") {
+                blocks = corpus_.find_duplicates(opts_);
+            } else if (cmd == "query" && line >> name) {
+                if (!corpus_.contains(name)) return reply(fd, "error: not indexed: " + name + "\n");
+                blocks = corpus_.find_duplicates_of(name, opts_);
+            } else if (size_t length = 0; cmd == "check" && line >> name >> length) {
+                if (length > kMaxCheckBytes) {
+                    return reply(fd, "error: buffer longer than " + std::to_string(kMaxCheckBytes) + " bytes\n");
+                }
+                while (body.size() < length) {
+                    ssize_t n = ::read(fd, chunk, sizeof(chunk));
+                    if (n <= 0) return reply(fd, "error: short buffer\n");
+                    body.append(chunk, static_cast<size_t>(n));
+                }
+                body.resize(length);
+                blocks = check_buffer(name, body);
+            } else {
+                return reply(fd, "error: expected 'scan', 'query PATH' or 'check NAME LENGTH'\n");
+            }
+            std::ostringstream out;
+            YamlWriter yaml(out, opts_.max_occurrences);
+            visit_blocks(blocks, yaml);
+            reply(fd, out.str());
+        } catch (const std::exception& e) {
+            reply(fd, std::string("error: ") + e.what() + "\n");
+        }
+    }
+
+    // Match `text` as document `name`, then put the indexed state back (also
+    // when matching throws).
+    std::vector<DuplicateBlock> check_buffer(const std::string& name, const std::string& text) {
+        std::vector<DuplicateBlock> blocks;
+        try {
+            if (corpus_.add_buffer(name, text)) blocks = corpus_.find_duplicates_of(name, opts_);
+        } catch (...) {
+            restore(name);
+            throw;
+        }
+        restore(name);
+        return blocks;
+    }
+
+    void restore(const std::string& name) {
+        auto it = indexed_.find(key_of(name));
+        if (it != indexed_.end()) load(it->second);
+        else corpus_.remove(name);
+    }
+
+    static void reply(int fd, const std::string& s) {
+        size_t off = 0;
+        while (off < s.size()) {
+            ssize_t n = ::write(fd, s.data() + off, s.size() - off);
+            if (n <= 0) return;
+            off += static_cast<size_t>(n);
+        }
+    }
+
+    ScanOptions opts_;
+    std::vector<std::string> patterns_;
+    GlobSet globs_;
+    Corpus corpus_;
+    std::map<std::string, fs::path> indexed_;   // key_of(path) -> path as loaded
+    std::unordered_map<int, fs::path> watches_; // inotify wd -> directory
+    int inotify_fd_ = -1;
+    int listen_fd_ = -1;
+    std::string socket_path_;
+};
+
+int run_server(const ScanOptions& opts, const std::vector<std::string>& patterns, const fs::path& socket_path) {
+    struct sigaction sa {};
+    sa.sa_handler = on_stop_signal;
+    sigemptyset(&sa.sa_mask);
+    ::sigaction(SIGINT, &sa, nullptr);
+    ::sigaction(SIGTERM, &sa, nullptr);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    Server server(opts, patterns);
+    if (!server.start(socket_path)) return 2;
+    server.run();
+    return 0;
+}
+
+#else
+
+int run_server(const ScanOptions&, const std::vector<std::string>&, const fs::path&) {
+    std::cerr << "serve is only supported on Linux\n";
+    return 2;
+}
+
+#endif
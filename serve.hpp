@@ -0,0 +1,14 @@
+// dryfinder serve: keeps the corpus in memory, follows file changes and
+// answers requests on a Unix domain socket.
+#pragma once
+
+#include "dryfinder/dryfinder.hpp"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Index the files matching `patterns` and serve requests on `socket_path`
+// until SIGINT/SIGTERM. Returns the process exit code.
+int run_server(const dryfinder::ScanOptions& opts, const std::vector<std::string>& patterns,
+               const std::filesystem::path& socket_path);
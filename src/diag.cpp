@@ -0,0 +1,123 @@
+#include "diag.hpp"
+
+#include <iostream>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+namespace dryfinder {
+
+int g_log_level[static_cast<size_t>(LogSub::Count)] = {};
+
+Stats g_stats;
+
+bool parse_debug_spec(const std::string& spec) {
+    std::stringstream ss(spec);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        size_t colon = item.find(':');
+        std::string name = colon == std::string::npos ? "" : item.substr(0, colon);
+        std::string lvl  = colon == std::string::npos ? item : item.substr(colon + 1);
+        int level;
+        try {
+            size_t used = 0;
+            level = std::stoi(lvl, &used);
+            if (used != lvl.size() || level < 0) return false;
+        } catch (...) {
+            return false;
+        }
+        if (name.empty()) {
+            for (auto& l : g_log_level) l = level;
+            continue;
+        }
+        bool found = false;
+        for (size_t i = 0; i < static_cast<size_t>(LogSub::Count); ++i) {
+            if (name == kLogSubNames[i]) { g_log_level[i] = level; found = true; }
+        }
+        if (!found) return false;
+    }
+    return true;
+}
+
+void set_log_level(int level) {
+    for (auto& l : g_log_level) l = level;
+}
+
+// Peak resident set size in bytes, 0 if unknown on this platform.
+static uint64_t peak_rss_bytes() {
+#if defined(__unix__) || defined(__APPLE__)
+    struct rusage ru {};
+    if (getrusage(RUSAGE_SELF, &ru) != 0) return 0;
+#if defined(__APPLE__)
+    return static_cast<uint64_t>(ru.ru_maxrss);        // bytes
+#else
+    return static_cast<uint64_t>(ru.ru_maxrss) * 1024; // kilobytes
+#endif
+#else
+    return 0;
+#endif
+}
+
+void print_stats(double total_seconds) {
+    const Stats& s = g_stats;
+    const std::pair<const char*, uint64_t> counters[] = {
+        { "files", s.files },
+        { "files_binary", s.files_binary },
+        { "bytes_read", s.bytes_read },
+        { "lines", s.lines },
+        { "units", s.units },
+        { "windows", s.windows },
+        { "candidate_groups", s.candidate_groups },
+        { "blocks", s.blocks },
+        { "peak_rss_bytes", peak_rss_bytes() },
+    };
+    // Time outside the instrumented phases (argument parsing, freeing the
+    // index, ...).
+    double other = total_seconds;
+    for (double v : s.seconds) other -= v;
+    if (other < 0) other = 0;
+
+    std::ostringstream oss;
+    oss.setf(std::ios::fixed);
+    oss.precision(6);
+    if (s.json) {
+        oss << "{\"phases\":{";
+        for (size_t i = 0; i < static_cast<size_t>(Phase::Count); ++i) {
+            oss << (i ? "," : "") << '"' << kPhaseNames[i] << "\":" << s.seconds[i];
+        }
+        oss << ",\"other\":" << other << "},\"total_seconds\":" << total_seconds << ",\"counters\":{";
+        bool first = true;
+        for (const auto& [name, v] : counters) {
+            oss << (first ? "" : ",") << '"' << name << "\":" << v;
+            first = false;
+        }
+        oss << "}}\n";
+    } else {
+        oss << "phase              seconds      share\n";
+        for (size_t i = 0; i < static_cast<size_t>(Phase::Count); ++i) {
+            double share = total_seconds > 0 ? 100.0 * s.seconds[i] / total_seconds : 0.0;
+            char row[96];
+            std::snprintf(row, sizeof(row), "%-16s %10.6f %9.1f%%\n", kPhaseNames[i], s.seconds[i], share);
+            oss << row;
+        }
+        char row[96];
+        std::snprintf(row, sizeof(row), "%-16s %10.6f %9.1f%%\n", "other", other,
+                      total_seconds > 0 ? 100.0 * other / total_seconds : 0.0);
+        oss << row;
+        std::snprintf(row, sizeof(row), "%-16s %10.6f\n", "total", total_seconds);
+        oss << row << "\ncounter                       value\n";
+        for (const auto& [name, v] : counters) {
+            std::snprintf(row, sizeof(row), "%-20s %14llu\n", name, static_cast<unsigned long long>(v));
+            oss << row;
+        }
+        double lines_per_s = total_seconds > 0 ? static_cast<double>(s.lines) / total_seconds : 0.0;
+        double mb_per_s = total_seconds > 0 ? static_cast<double>(s.bytes_read) / 1e6 / total_seconds : 0.0;
+        std::snprintf(row, sizeof(row), "\nthroughput: %.0f lines/s, %.2f MB/s\n", lines_per_s, mb_per_s);
+        oss << row;
+    }
+    std::cerr << oss.str();
+}
+
+} // namespace dryfinder
@@ -0,0 +1,203 @@
+// Diagnostics shared by the library and the command-line tool: leveled
+// debug logging (DLOG) and the --stats phase timers and counters.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+namespace dryfinder {
+
+// ----------------------------- Debug ---------------------------------
+// Lazy, leveled debug logging. DLOG(sub, level, a << b << ...) evaluates and
+// formats its arguments only when subsystem `sub` is enabled at `level`, so
+// the disabled path costs one load and one compare. Messages are collected
+// in a per-thread buffer and written to stderr in chunks under a mutex, so
+// threads never contend per line. Level 1 is summaries, level 2 per-file
+// detail; plain --debug enables level 2 everywhere.
+
+enum class LogSub : uint8_t { Cli, Glob, Load, Match, Emit, Count };
+
+inline constexpr const char* kLogSubNames[] = { "cli", "glob", "load", "match", "emit" };
+
+extern int g_log_level[static_cast<size_t>(LogSub::Count)];
+
+inline bool log_enabled(LogSub sub, int level) {
+    return g_log_level[static_cast<size_t>(sub)] >= level;
+}
+
+class LogSink {
+public:
+    static LogSink& local() {
+        thread_local LogSink sink;
+        return sink;
+    }
+
+    std::ostream& begin(LogSub sub) {
+        os_.str(std::string());
+        os_ << "[debug:" << kLogSubNames[static_cast<size_t>(sub)] << "] ";
+        return os_;
+    }
+
+    void end() {
+        os_ << '\n';
+        buf_ += os_.str();
+        if (buf_.size() >= kFlushBytes) flush();
+    }
+
+    void flush() {
+        if (buf_.empty()) return;
+        std::lock_guard<std::mutex> lock(mutex());
+        std::fwrite(buf_.data(), 1, buf_.size(), stderr);
+        std::fflush(stderr);
+        buf_.clear();
+    }
+
+    ~LogSink() { flush(); }
+
+private:
+    static constexpr size_t kFlushBytes = 16 * 1024;
+
+    static std::mutex& mutex() {
+        static std::mutex m;
+        return m;
+    }
+
+    std::ostringstream os_;
+    std::string buf_;
+};
+
+#define DLOG(sub, level, expr)                                \
+    do {                                                      \
+        if (::dryfinder::log_enabled((sub), (level))) {       \
+            auto& dlog_sink_ = ::dryfinder::LogSink::local(); \
+            dlog_sink_.begin(sub) << expr;                    \
+            dlog_sink_.end();                                 \
+        }                                                     \
+    } while (0)
+
+// Write out this thread's buffered messages (phase boundaries, exit).
+inline void log_flush() {
+    LogSink::local().flush();
+}
+
+// Parse a --debug spec: "N" sets every subsystem to level N, "sub:N[,...]"
+// sets individual subsystems. Returns false on malformed input.
+bool parse_debug_spec(const std::string& spec);
+
+// Set every subsystem to `level` (plain --debug uses 2).
+void set_log_level(int level);
+
+// ----------------------------- Stats ---------------------------------
+// --stats: per-phase wall time (monotonic clock) and work counters, printed
+// to stderr as a table or as JSON. Timers are no-ops unless enabled.
+// Counters are atomic so loader threads can bump them; phase timers are
+// only run on the calling thread, so phases stay wall time. Worker threads
+// of a pipelined load report their time per phase through WorkerTimer, and
+// PipelineTimer folds it into the phases when the pipeline is done.
+
+enum class Phase { Glob, Sniff, Load, Seed, Extend, Aggregate, Sort, Emit, Count };
+
+inline constexpr const char* kPhaseNames[] = {
+    "glob", "sniff", "load", "seed", "extend", "aggregate", "sort", "emit",
+};
+
+struct Stats {
+    bool enabled = false;
+    bool json = false;
+    double seconds[static_cast<size_t>(Phase::Count)] = {};
+    std::atomic<uint64_t> files = 0;            // files loaded (text)
+    std::atomic<uint64_t> files_binary = 0;     // files skipped as binary
+    std::atomic<uint64_t> bytes_read = 0;
+    std::atomic<uint64_t> lines = 0;
+    std::atomic<uint64_t> units = 0;            // matching units (lines or tokens)
+    std::atomic<uint64_t> windows = 0;          // seed windows hashed
+    std::atomic<uint64_t> candidate_groups = 0; // verified seed groups with >= 2 hits
+    std::atomic<uint64_t> blocks = 0;           // blocks reported
+    std::atomic<uint64_t> worker_ns[static_cast<size_t>(Phase::Count)] = {}; // not yet folded
+};
+
+extern Stats g_stats;
+
+class PhaseTimer {
+public:
+    explicit PhaseTimer(Phase p, bool on = true) : phase_(p), on_(on && g_stats.enabled) {
+        if (on_) start_ = std::chrono::steady_clock::now();
+    }
+    ~PhaseTimer() {
+        if (!on_) return;
+        std::chrono::duration<double> d = std::chrono::steady_clock::now() - start_;
+        g_stats.seconds[static_cast<size_t>(phase_)] += d.count();
+    }
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+private:
+    Phase phase_;
+    bool on_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Adds time spent in a phase on a worker thread.
+inline void add_worker_time(Phase p, std::chrono::steady_clock::duration d) {
+    if (!g_stats.enabled) return;
+    g_stats.worker_ns[static_cast<size_t>(p)] +=
+        static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+}
+
+// PhaseTimer for worker threads: the scope's time is added with
+// add_worker_time().
+class WorkerTimer {
+public:
+    explicit WorkerTimer(Phase p, bool on = true) : phase_(p), on_(on && g_stats.enabled) {
+        if (on_) start_ = std::chrono::steady_clock::now();
+    }
+    ~WorkerTimer() {
+        if (on_) add_worker_time(phase_, std::chrono::steady_clock::now() - start_);
+    }
+    WorkerTimer(const WorkerTimer&) = delete;
+    WorkerTimer& operator=(const WorkerTimer&) = delete;
+
+private:
+    Phase phase_;
+    bool on_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Wall time of a pipelined stage on the calling thread. On exit the time
+// its workers reported is moved into their phases and the rest of the wall
+// time goes to `phase`. Worker time of several threads can overlap, so the
+// split is an attribution, not a partition; `phase` never goes negative.
+class PipelineTimer {
+public:
+    explicit PipelineTimer(Phase p) : phase_(p), on_(g_stats.enabled) {
+        if (on_) start_ = std::chrono::steady_clock::now();
+    }
+    ~PipelineTimer() {
+        if (!on_) return;
+        double rest = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+        for (size_t i = 0; i < static_cast<size_t>(Phase::Count); ++i) {
+            const double s = static_cast<double>(g_stats.worker_ns[i].exchange(0)) / 1e9;
+            g_stats.seconds[i] += s;
+            rest -= s;
+        }
+        g_stats.seconds[static_cast<size_t>(phase_)] += std::max(rest, 0.0);
+    }
+    PipelineTimer(const PipelineTimer&) = delete;
+    PipelineTimer& operator=(const PipelineTimer&) = delete;
+
+private:
+    Phase phase_;
+    bool on_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Write the --stats report for a run of `total_seconds` to stderr.
+void print_stats(double total_seconds);
+
+} // namespace dryfinder
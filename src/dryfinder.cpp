@@ -0,0 +1,3453 @@
+// libdryfinder implementation: glob expansion, file loading and
+// normalization, the matching engines, and YAML emission.
+#include "dryfinder/dryfinder.hpp"
+#include "diag.hpp"
+#include "uring.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <regex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace dryfinder {
+
+namespace fs = std::filesystem;
+
+// ----------------------------- Utilities ------------------------------
+
+static inline std::string to_generic_string(const fs::path& p) {
+    return p.generic_string();
+}
+
+static inline bool has_glob_chars(const std::string& s) {
+    for (char c : s) if (c == '*' || c == '?') return true;
+    return false;
+}
+
+static std::string lstrip_dots_slashes(std::string s) {
+    // normalize leading "./"
+    while (s.size() >= 2 && s[0] == '.' && (s[1] == '/' )) {
+        s.erase(0, 2);
+    }
+    // and leading '/' (avoid absolute)
+    while (!s.empty() && s[0] == '/') s.erase(0, 1);
+    return s;
+}
+
+static std::string_view strip_utf8_bom(std::string_view s) {
+    if (s.size() >= 3 &&
+        static_cast<unsigned char>(s[0]) == 0xEF &&
+        static_cast<unsigned char>(s[1]) == 0xBB &&
+        static_cast<unsigned char>(s[2]) == 0xBF) {
+        return s.substr(3);
+    }
+    return s;
+}
+
+static void rstrip_cr(std::string_view& s) {
+    if (!s.empty() && s.back() == '\r') s.remove_suffix(1);
+}
+
+// YAML escaping for double-quoted scalars
+static std::string yaml_escape(const std::string& in) {
+    std::string out;
+    out.reserve(in.size() + 8);
+    out.push_back('"');
+    for (char c : in) {
+        switch (c) {
+            case '\\': out += "\\\\"; break;
+            case '\"': out += "\\\""; break;
+            case '\n': out += "\\n"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    // control chars -> \xHH
+                    char buf[5];
+                    std::snprintf(buf, sizeof(buf), "\\x%02X", (unsigned char)c);
+                    out += buf;
+                } else {
+                    out.push_back(c);
+                }
+        }
+    }
+    out.push_back('"');
+    return out;
+}
+
+// Count bytes in the "non-text control" class (everything below 0x20 except
+// \t \n \v \f \r) and report whether a NUL byte was seen. Uses SSE2 when
+// available (baseline on x86-64), 16 bytes per step; scalar tail/fallback.
+static size_t count_control_bytes(const unsigned char* data, size_t n, bool& saw_nul) {
+    size_t ctrl = 0;
+    size_t i = 0;
+    saw_nul = false;
+#if defined(__SSE2__)
+    const __m128i k1f  = _mm_set1_epi8(0x1F);
+    const __m128i k09  = _mm_set1_epi8(0x09);
+    const __m128i k04  = _mm_set1_epi8(0x04);
+    const __m128i zero = _mm_setzero_si128();
+    int nul_mask = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        // c < 0x20  <=>  min(c, 0x1F) == c   (unsigned)
+        __m128i lt20 = _mm_cmpeq_epi8(_mm_min_epu8(x, k1f), x);
+        // 0x09 <= c <= 0x0D  <=>  (c - 0x09) <= 4   (unsigned, wrapping)
+        __m128i t  = _mm_sub_epi8(x, k09);
+        __m128i ws = _mm_cmpeq_epi8(_mm_min_epu8(t, k04), t);
+        __m128i cc = _mm_andnot_si128(ws, lt20);
+        ctrl += static_cast<size_t>(std::popcount(static_cast<unsigned>(_mm_movemask_epi8(cc))));
+        nul_mask |= _mm_movemask_epi8(_mm_cmpeq_epi8(x, zero));
+    }
+    saw_nul = (nul_mask != 0);
+#endif
+    for (; i < n; ++i) {
+        unsigned char c = data[i];
+        if (c == 0) saw_nul = true;
+        // allow common whitespace: \t(0x09), \n(0x0A), \r(0x0D)
+        if (c < 0x09 || (c > 0x0D && c < 0x20)) ++ctrl;
+    }
+    return ctrl;
+}
+
+// Quick binary-file sniffing on an already-loaded buffer: treat files with
+// NUL bytes or a high ratio of non-text control characters in the first
+// `sniff_max` bytes as binary. sniff_max == 0 disables the check. Only that
+// prefix is looked at, so the readers can stop after it (see
+// read_file_bytes()).
+static bool sniff_binary(std::string_view buf, size_t sniff_max, double max_ratio,
+                         size_t& nontext, bool& saw_nul) {
+    const size_t n = std::min(buf.size(), sniff_max);
+    saw_nul = false;
+    nontext = 0;
+    if (n == 0) return false; // empty files are not considered binary
+    nontext = count_control_bytes(reinterpret_cast<const unsigned char*>(buf.data()), n, saw_nul);
+    return saw_nul || static_cast<double>(nontext) / static_cast<double>(n) > max_ratio;
+}
+
+static bool is_probably_binary(std::string_view buf, const fs::path& p,
+                               size_t sniff_max, double max_ratio) {
+    size_t nontext;
+    bool saw_nul;
+    const bool isbin = sniff_binary(buf, sniff_max, max_ratio, nontext, saw_nul);
+    const size_t n = std::min(buf.size(), sniff_max);
+    if (n == 0) return false;
+    if (saw_nul) {
+        DLOG(LogSub::Load, 2, "binary sniff (NUL) -> " << to_generic_string(p));
+        return true;
+    }
+    double ratio = static_cast<double>(nontext) / static_cast<double>(n);
+    DLOG(LogSub::Load, 2, "binary sniff stats: " << to_generic_string(p)
+         << " bytes=" << n << " ctrl=" << nontext
+         << " ratio=" << ratio
+         << " -> " << (isbin ? "binary" : "text"));
+    return isbin;
+}
+
+// ----------------------------- Glob Engine ----------------------------
+// Minimal glob-to-regex supporting *, ?, ** (recursive)
+// We determine a base directory (prefix before first glob char),
+// iterate recursively from there, and match the *suffix pattern* as regex
+// against the path relative to that base.
+
+struct CompiledPattern {
+    fs::path base_dir;
+    std::regex regex_suffix; // matches relative path from base_dir
+};
+
+static fs::path compute_base_dir(const std::string& generic_pattern) {
+    // Find first glob char
+    size_t first = std::string::npos;
+    for (size_t i = 0; i < generic_pattern.size(); ++i) {
+        char c = generic_pattern[i];
+        if (c == '*' || c == '?') { first = i; break; }
+    }
+    std::string prefix = generic_pattern;
+    if (first != std::string::npos) {
+        // take substring up to last '/' before first glob
+        size_t slash = generic_pattern.rfind('/', first);
+        if (slash != std::string::npos) prefix = generic_pattern.substr(0, slash);
+        else prefix = ".";
+    }
+    if (prefix.empty()) prefix = ".";
+    return fs::path(prefix);
+}
+
+static std::string to_regex_from_glob_suffix(const std::string& suffix) {
+    // Convert glob suffix (relative to base) to a full regex ^...$
+    std::string out;
+    out.reserve(suffix.size() * 2 + 5);
+    out += "^";
+    for (size_t i = 0; i < suffix.size(); ++i) {
+        char c = suffix[i];
+        if (c == '*') {
+            // check for **
+            size_t j = i;
+            while (j < suffix.size() && suffix[j] == '*') ++j;
+            size_t stars = j - i;
+            i = j - 1;
+            if (stars >= 2) {
+                out += ".*"; // ** -> match across separators
+            } else {
+                out += "[^/]*"; // * -> no slash
+            }
+        } else if (c == '?') {
+            out += "[^/]";
+        } else {
+            // escape regex specials
+            switch (c) {
+                case '.': case '+': case '(': case ')':
+                case '^': case '$': case '|': case '{':
+                case '}': case '[': case ']': case '\\':
+                    out.push_back('\\'); out.push_back(c); break;
+                default:
+                    out.push_back(c);
+            }
+        }
+    }
+    out += "$";
+    return out;
+}
+
+static CompiledPattern compile_pattern(const std::string& pattern_raw) {
+    std::string p = to_generic_string(fs::path(pattern_raw));
+    p = lstrip_dots_slashes(p);
+    fs::path base = compute_base_dir(p);
+    std::string base_generic = to_generic_string(base);
+    base_generic = lstrip_dots_slashes(base_generic);
+
+    // Build suffix: pattern without the base prefix (and possible '/')
+    std::string suffix;
+    if (!base_generic.empty()) {
+        if (p.rfind(base_generic + "/", 0) == 0) {
+            suffix = p.substr(base_generic.size() + 1);
+        } else if (p == base_generic) {
+            suffix = ""; // degenerate, match directory itself
+        } else {
+            // Base couldn't be trimmed as prefix (e.g., relative forms). Fallback:
+            size_t pos = p.find_first_of("*?");
+            size_t slash = p.rfind('/', (pos == std::string::npos ? p.size()-1 : pos));
+            if (slash != std::string::npos && slash + 1 < p.size())
+                suffix = p.substr(slash + 1);
+            else
+                suffix = p;
+        }
+    } else {
+        suffix = p;
+    }
+    if (suffix.empty()) suffix = "**"; // match everything under base
+
+    std::string re_str = to_regex_from_glob_suffix(suffix);
+    DLOG(LogSub::Glob, 1, "compile_pattern: base=" << base_generic
+         << " suffix=" << suffix << " regex=" << re_str);
+    std::regex re(re_str, std::regex::ECMAScript);
+    return { base, re };
+}
+
+// Walk the base directory of every pattern and call fn(path) for each
+// matching regular file, once per path, in directory order.
+template <typename Fn>
+static size_t walk_globs(const std::vector<std::string>& patterns, Fn&& fn) {
+    std::unordered_set<std::string> seen; // generic string paths to dedupe
+    for (const auto& pat : patterns) {
+        CompiledPattern cp = compile_pattern(pat);
+        fs::path base = cp.base_dir.empty() ? fs::path(".") : cp.base_dir;
+        DLOG(LogSub::Glob, 1, "glob pattern: " << pat << " | base=" << to_generic_string(base));
+        if (!fs::exists(base)) {
+            DLOG(LogSub::Glob, 1, "  base does not exist, skipping");
+            continue;
+        }
+        if (fs::is_regular_file(base)) {
+            std::string rel = to_generic_string(base.filename());
+            if (std::regex_match(rel, cp.regex_suffix)) {
+                std::string g = to_generic_string(base);
+                if (seen.insert(g).second) fn(base);
+            }
+            continue;
+        }
+
+        size_t added = 0;
+        for (fs::recursive_directory_iterator it(base, fs::directory_options::follow_directory_symlink);
+             it != fs::recursive_directory_iterator(); ++it) {
+            if (!it->is_regular_file()) continue;
+            std::error_code ec;
+            fs::path relPath = fs::relative(it->path(), base, ec);
+            if (ec) relPath = it->path().lexically_relative(base); // best-effort
+            std::string rel = to_generic_string(relPath);
+            if (std::regex_match(rel, cp.regex_suffix)) {
+                std::string g = to_generic_string(it->path());
+                if (seen.insert(g).second) {
+                    fn(it->path());
+                    ++added;
+                }
+            }
+        }
+        DLOG(LogSub::Glob, 1, "  matched files: " << added);
+    }
+    DLOG(LogSub::Glob, 1, "total unique files matched across all globs: " << seen.size());
+    return seen.size();
+}
+
+static bool path_less(const fs::path& a, const fs::path& b) {
+    return to_generic_string(a) < to_generic_string(b);
+}
+
+std::vector<fs::path> expand_globs(const std::vector<std::string>& patterns) {
+    PhaseTimer timer(Phase::Glob);
+    std::vector<fs::path> results;
+    walk_globs(patterns, [&](const fs::path& p) { results.push_back(p); });
+    std::sort(results.begin(), results.end(), path_less);
+    return results;
+}
+
+struct GlobSet::Impl {
+    std::vector<CompiledPattern> patterns;
+};
+
+GlobSet::GlobSet(const std::vector<std::string>& patterns) : impl_(std::make_unique<Impl>()) {
+    for (const auto& p : patterns) impl_->patterns.push_back(compile_pattern(p));
+}
+
+GlobSet::~GlobSet() = default;
+GlobSet::GlobSet(GlobSet&&) noexcept = default;
+GlobSet& GlobSet::operator=(GlobSet&&) noexcept = default;
+
+bool GlobSet::matches(const fs::path& path) const {
+    const fs::path p = path.lexically_normal();
+    for (const auto& cp : impl_->patterns) {
+        fs::path base = cp.base_dir.empty() ? fs::path(".") : cp.base_dir;
+        std::string rel = to_generic_string(p.lexically_relative(base.lexically_normal()));
+        if (rel.empty() || rel.rfind("..", 0) == 0) continue;
+        if (std::regex_match(rel, cp.regex_suffix)) return true;
+    }
+    return false;
+}
+
+std::vector<fs::path> GlobSet::base_dirs() const {
+    std::vector<fs::path> out;
+    for (const auto& cp : impl_->patterns) out.push_back(cp.base_dir.empty() ? fs::path(".") : cp.base_dir);
+    return out;
+}
+
+// ----------------------------- Tokenizer ------------------------------
+// Lightweight streaming lexer for C/C++ and similar languages. It is fed one
+// line at a time (block-comment state carries across lines), drops
+// whitespace and comments and hands each token to a callback as a view into
+// the line, so no per-token allocation happens here.
+
+enum class TokKind : uint8_t { Ident, Number, String, Punct };
+
+enum class CommentStyle : uint8_t {
+    CLike, // // line, /* block */
+    Hash,  // # line (scripts, config files)
+};
+
+static CommentStyle comment_style_for(const fs::path& p) {
+    static const std::unordered_set<std::string> hash_exts = {
+        ".py", ".sh", ".bash", ".zsh", ".rb", ".pl", ".pm", ".r", ".cmake",
+        ".yaml", ".yml", ".toml", ".cfg", ".conf", ".ini", ".mk", ".nim",
+    };
+    std::string ext = p.extension().string();
+    for (auto& c : ext) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    std::string name = p.filename().string();
+    if (hash_exts.count(ext) || name == "Makefile" || name == "CMakeLists.txt" ||
+        name == "meson.build") {
+        return CommentStyle::Hash;
+    }
+    return CommentStyle::CLike;
+}
+
+static inline bool is_ident_start(unsigned char c) {
+    return std::isalpha(c) || c == '_' || c == '$' || c >= 0x80;
+}
+
+static inline bool is_ident_char(unsigned char c) {
+    return std::isalnum(c) || c == '_' || c == '$' || c >= 0x80;
+}
+
+class Lexer {
+public:
+    explicit Lexer(CommentStyle style) : style_(style) {}
+
+    // Calls emit(std::string_view text, TokKind kind) for every token.
+    template <typename Emit>
+    void lex_line(std::string_view s, Emit&& emit) {
+        size_t i = 0;
+        const size_t n = s.size();
+        while (i < n) {
+            if (in_block_comment_) {
+                size_t end = s.find("*/", i);
+                if (end == std::string_view::npos) return;
+                in_block_comment_ = false;
+                i = end + 2;
+                continue;
+            }
+            unsigned char c = static_cast<unsigned char>(s[i]);
+            if (c == ' ' || c == '\t' || c == '\f' || c == '\v') { ++i; continue; }
+            if (style_ == CommentStyle::CLike && c == '/' && i + 1 < n) {
+                if (s[i + 1] == '/') return;
+                if (s[i + 1] == '*') { in_block_comment_ = true; i += 2; continue; }
+            }
+            if (style_ == CommentStyle::Hash && c == '#') return;
+
+            size_t b = i;
+            if (is_ident_start(c)) {
+                while (i < n && is_ident_char(static_cast<unsigned char>(s[i]))) ++i;
+                emit(s.substr(b, i - b), TokKind::Ident);
+            } else if (std::isdigit(c) ||
+                       (c == '.' && i + 1 < n && std::isdigit(static_cast<unsigned char>(s[i + 1])))) {
+                ++i;
+                while (i < n) {
+                    unsigned char d = static_cast<unsigned char>(s[i]);
+                    if (std::isalnum(d) || d == '.' || d == '_' || d == '\'') { ++i; continue; }
+                    // exponent sign: 1e-5, 0x1p+3
+                    char prev = s[i - 1];
+                    if ((d == '+' || d == '-') &&
+                        (prev == 'e' || prev == 'E' || prev == 'p' || prev == 'P')) { ++i; continue; }
+                    break;
+                }
+                emit(s.substr(b, i - b), TokKind::Number);
+            } else if (c == '"' || c == '\'') {
+                ++i;
+                while (i < n && static_cast<unsigned char>(s[i]) != c) {
+                    i += (s[i] == '\\' && i + 1 < n) ? 2 : 1;
+                }
+                if (i < n) ++i; // closing quote (unterminated literals end at EOL)
+                emit(s.substr(b, i - b), TokKind::String);
+            } else {
+                i += punct_len(s, i);
+                emit(s.substr(b, i - b), TokKind::Punct);
+            }
+        }
+    }
+
+private:
+    static size_t punct_len(std::string_view s, size_t i) {
+        static constexpr std::string_view ops3[] = { "<<=", ">>=", "...", "->*", "<=>" };
+        static constexpr std::string_view ops2[] = {
+            "::", "->", "++", "--", "<<", ">>", "<=", ">=", "==", "!=", "&&", "||",
+            "+=", "-=", "*=", "/=", "%=", "&=", "|=", "^=", "##", ".*",
+        };
+        std::string_view rest = s.substr(i);
+        for (auto op : ops3) if (rest.substr(0, 3) == op) return 3;
+        for (auto op : ops2) if (rest.substr(0, 2) == op) return 2;
+        return 1;
+    }
+
+    CommentStyle style_;
+    bool in_block_comment_ = false;
+};
+
+// Keywords survive --normalize-identifiers; every other identifier becomes
+// a placeholder. C/C++ plus the most common words of other C-like and
+// scripting languages.
+static bool is_keyword(std::string_view s) {
+    static const std::unordered_set<std::string_view> kws = {
+        "alignas", "alignof", "asm", "auto", "bool", "break", "case", "catch",
+        "char", "class", "concept", "const", "consteval", "constexpr",
+        "constinit", "const_cast", "continue", "co_await", "co_return",
+        "co_yield", "decltype", "default", "delete", "do", "double",
+        "dynamic_cast", "else", "enum", "explicit", "export", "extern", "false",
+        "float", "for", "friend", "goto", "if", "inline", "int", "long",
+        "mutable", "namespace", "new", "noexcept", "nullptr", "operator",
+        "private", "protected", "public", "register", "reinterpret_cast",
+        "requires", "return", "short", "signed", "sizeof", "static",
+        "static_assert", "static_cast", "struct", "switch", "template", "this",
+        "thread_local", "throw", "true", "try", "typedef", "typeid", "typename",
+        "union", "unsigned", "using", "virtual", "void", "volatile", "wchar_t",
+        "while", "define", "include", "ifdef", "ifndef", "endif", "elif",
+        "undef", "pragma",
+        // other languages
+        "def", "lambda", "pass", "None", "True", "False", "and", "or", "not",
+        "in", "is", "import", "from", "as", "with", "yield", "raise", "except",
+        "finally", "function", "var", "let", "fn", "func", "match", "impl",
+        "trait", "pub", "mut", "self", "super", "interface", "extends",
+        "implements", "package", "null", "nil", "then", "end", "fi", "done",
+    };
+    return kws.count(s) != 0;
+}
+
+// Placeholder class used for a token under --normalize-identifiers.
+static std::string_view canonical_token(std::string_view tok, TokKind kind) {
+    switch (kind) {
+        case TokKind::Ident:  return is_keyword(tok) ? tok : std::string_view("$id");
+        case TokKind::Number: return "$num";
+        case TokKind::String: return "$str";
+        case TokKind::Punct:  return tok;
+    }
+    return tok;
+}
+
+// --------------------------- Duplicate Finder -------------------------
+
+// The lines of a file in one buffer: line i is text[offsets[i],
+// offsets[i + 1]). One allocation per file instead of one string per line,
+// and lines are read in order from contiguous memory.
+struct LineTable {
+    std::string text;
+    std::vector<size_t> offsets{ 0 };
+
+    size_t size() const { return offsets.size() - 1; }
+    bool empty() const { return size() == 0; }
+    std::string_view operator[](size_t i) const {
+        return std::string_view(text).substr(offsets[i], offsets[i + 1] - offsets[i]);
+    }
+    bool operator==(const LineTable& o) const { return offsets == o.offsets && text == o.text; }
+
+    // Copies of lines [first, last), as reported in a block.
+    std::vector<std::string> slice(size_t first, size_t last) const {
+        std::vector<std::string> out;
+        out.reserve(last - first);
+        for (size_t i = first; i < last; ++i) out.emplace_back((*this)[i]);
+        return out;
+    }
+};
+
+struct FileData {
+    fs::path path;
+    LineTable lines;                 // original text: normalized LF, no trailing CR
+    std::vector<uint32_t> ids;       // normalized line (or token) IDs used for matching
+    std::vector<uint32_t> line_of;   // ids[i] comes from lines[line_of[i]]
+    uint64_t content_hash = 0;       // of the raw bytes, to spot identical files
+};
+
+// Read the whole file with a single open/read. Returns false if the file
+// cannot be opened (callers then treat it as empty, as before).
+// With `sniff`, the file's first sniff->binary_sniff_bytes are read on
+// their own and a file they show to be binary is not read further: the
+// sniff at indexing sees the same prefix and skips it.
+static bool read_file_bytes(const fs::path& p, std::string& buf, const LoadOptions* sniff = nullptr) {
+    std::ifstream in(p, std::ios::binary);
+    buf.clear();
+    if (!in) return false;
+    if (sniff && sniff->binary_sniff_bytes > 0) {
+        buf.resize(sniff->binary_sniff_bytes);
+        in.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+        buf.resize(static_cast<size_t>(in.gcount()));
+        if (!in) return true; // the whole file fit in the prefix
+        size_t nontext;
+        bool saw_nul;
+        if (sniff_binary(buf, sniff->binary_sniff_bytes, sniff->binary_ratio, nontext, saw_nul)) return true;
+    }
+    std::error_code ec;
+    auto size = fs::file_size(p, ec);
+    if (!ec && size > buf.size()) {
+        const size_t have = buf.size();
+        buf.resize(static_cast<size_t>(size));
+        in.read(buf.data() + have, static_cast<std::streamsize>(buf.size() - have));
+        buf.resize(have + static_cast<size_t>(in.gcount()));
+    }
+    // Files that grew after stat (or report size 0, e.g. procfs): drain the rest.
+    char tmp[4096];
+    while (in.read(tmp, sizeof(tmp)) || in.gcount() > 0) {
+        buf.append(tmp, static_cast<size_t>(in.gcount()));
+    }
+    return true;
+}
+
+// Split a loaded buffer into lines with std::getline semantics: LF
+// separated, a trailing line without LF is kept, CRs before LF are dropped
+// and a UTF-8 BOM on the first line is removed.
+static LineTable split_lines_normalized(std::string_view buf) {
+    LineTable out;
+    out.text.reserve(buf.size());
+    size_t pos = 0;
+    while (pos < buf.size()) {
+        size_t nl = buf.find('\n', pos);
+        size_t end = (nl == std::string::npos) ? buf.size() : nl;
+        std::string_view line = buf.substr(pos, end - pos);
+        rstrip_cr(line);
+        if (out.empty()) line = strip_utf8_bom(line);
+        out.text.append(line);
+        out.offsets.push_back(out.text.size());
+        if (nl == std::string::npos) break;
+        pos = nl + 1;
+    }
+    return out;
+}
+
+// Whitespace normalization applied once per line at load time. Returns a
+// view into `in` when only trimming is needed, otherwise into `scratch`.
+// One instantiation per combination of whitespace options, so the line
+// loop that calls it tests none of them.
+template <bool IgnoreIndent, bool IgnoreTrailing, bool Collapse>
+static std::string_view normalize_line(std::string_view in, std::string& scratch) {
+    size_t b = 0, e = in.size();
+    if constexpr (IgnoreIndent) {
+        while (b < e && (in[b] == ' ' || in[b] == '\t')) ++b;
+    }
+    if constexpr (IgnoreTrailing) {
+        while (e > b && (in[e - 1] == ' ' || in[e - 1] == '\t')) --e;
+    }
+    if constexpr (!Collapse) {
+        return in.substr(b, e - b);
+    } else {
+        scratch.clear();
+        bool in_ws = false;
+        for (size_t i = b; i < e; ++i) {
+            char c = in[i];
+            if (c == ' ' || c == '\t') {
+                if (!in_ws) scratch.push_back(' ');
+                in_ws = true;
+            } else {
+                scratch.push_back(c);
+                in_ws = false;
+            }
+        }
+        return scratch;
+    }
+}
+
+// fn(std::true_type) or fn(std::false_type): turns a runtime option into a
+// template argument once, outside the loop that depends on it.
+template <typename Fn>
+static decltype(auto) with_bool(bool b, Fn&& fn) {
+    return b ? fn(std::true_type{}) : fn(std::false_type{});
+}
+
+static inline bool is_blank_line(std::string_view s) {
+    for (char c : s) if (c != ' ' && c != '\t') return false;
+    return true;
+}
+
+// splitmix64 finalizer: spreads small dense IDs over all 64 bits
+static inline uint64_t mix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+// Hash of unit text, independent of the IDs a process assigned.
+static uint64_t fnv1a64(std::string_view s) {
+    uint64_t h = 0xCBF29CE484222325ULL;
+    for (unsigned char c : s) {
+        h ^= c;
+        h *= 0x100000001B3ULL;
+    }
+    return h;
+}
+
+// Hash of a normalized unit, 8 bytes at a time. The interners key units by
+// it, so text is compared only when the hash and the length already match.
+static uint64_t unit_hash(std::string_view s) {
+    uint64_t h = s.size();
+    size_t i = 0;
+    for (; i + 8 <= s.size(); i += 8) {
+        uint64_t v;
+        std::memcpy(&v, s.data() + i, sizeof(v));
+        h = std::rotl((h ^ v) * 0x9E3779B97F4A7C15ULL, 29);
+    }
+    uint64_t tail = 0;
+    if (i < s.size()) std::memcpy(&tail, s.data() + i, s.size() - i);
+    return mix64(h ^ tail);
+}
+
+// Maps each distinct normalized line (or token) to a dense integer ID, so
+// matching compares integers instead of strings. Thread-safe: the table is
+// split into independently locked shards, so concurrent loaders rarely
+// contend. IDs are dense but their order depends on arrival; nothing in the
+// output depends on ID values.
+class StringInterner {
+public:
+    uint32_t intern(std::string_view s) {
+        const Probe key{ unit_hash(s), s };
+        Shard& sh = shards_[key.hash >> kShardShift];
+        std::lock_guard<std::mutex> lock(sh.mutex);
+        auto it = sh.ids.find(key);
+        if (it != sh.ids.end()) return it->second;
+        uint32_t id = next_.fetch_add(1, std::memory_order_relaxed);
+        sh.ids.emplace(Unit{ key.hash, std::string(s) }, id);
+        return id;
+    }
+    size_t size() const { return next_.load(std::memory_order_relaxed); }
+
+    // Interned strings indexed by ID.
+    std::vector<std::string_view> by_id() const {
+        std::vector<std::string_view> out(size());
+        for (const auto& sh : shards_) {
+            for (const auto& [u, id] : sh.ids) out[id] = u.text;
+        }
+        return out;
+    }
+
+private:
+    static constexpr size_t kShardBits = 6;
+    static constexpr size_t kShardShift = 64 - kShardBits;
+
+    // A unit keeps its unit_hash(): lookups reject on hash and length before
+    // comparing bytes, and growing a table never hashes text again.
+    struct Unit {
+        uint64_t hash;
+        std::string text;
+    };
+    struct Probe {
+        uint64_t hash;
+        std::string_view text;
+    };
+    struct UnitHash {
+        using is_transparent = void;
+        size_t operator()(const Unit& u) const { return static_cast<size_t>(u.hash); }
+        size_t operator()(const Probe& p) const { return static_cast<size_t>(p.hash); }
+    };
+    struct UnitEq {
+        using is_transparent = void;
+        template <typename A, typename B>
+        bool operator()(const A& a, const B& b) const {
+            return a.hash == b.hash && a.text.size() == b.text.size() &&
+                   std::string_view(a.text) == std::string_view(b.text);
+        }
+    };
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<Unit, uint32_t, UnitHash, UnitEq> ids;
+    };
+    std::array<Shard, size_t{1} << kShardBits> shards_;
+    std::atomic<uint32_t> next_{0};
+};
+
+// Fill fd.ids/fd.line_of from fd.lines according to the normalization options.
+// Type-2 canonical form of a line: its tokens with identifiers and literals
+// replaced by placeholder classes, joined by single spaces. Comments and
+// whitespace disappear, so the whitespace options are implied.
+static std::string_view canonical_line(std::string_view line, Lexer& lexer, std::string& scratch) {
+    scratch.clear();
+    lexer.lex_line(line, [&](std::string_view tok, TokKind kind) {
+        if (!scratch.empty()) scratch.push_back(' ');
+        scratch.append(canonical_token(tok, kind));
+    });
+    return scratch;
+}
+
+// Calls fn(normalize) with the line normalizer the options select, where
+// normalize(line, scratch) returns the normalized view of `line`.
+template <typename Fn>
+static void with_line_normalizer(const LoadOptions& o, const fs::path& path, Fn&& fn) {
+    if (o.normalize_identifiers) {
+        Lexer lexer(comment_style_for(path));
+        return fn([&lexer](std::string_view line, std::string& scratch) {
+            return canonical_line(line, lexer, scratch);
+        });
+    }
+    with_bool(o.ignore_indent, [&](auto indent) {
+        with_bool(o.ignore_trailing_ws, [&](auto trailing) {
+            with_bool(o.collapse_ws, [&](auto collapse) {
+                fn([](std::string_view line, std::string& scratch) {
+                    return normalize_line<decltype(indent)::value, decltype(trailing)::value,
+                                          decltype(collapse)::value>(line, scratch);
+                });
+            });
+        });
+    });
+}
+
+template <bool SkipBlank, typename Normalize, typename Interner>
+static void assign_line_ids(FileData& fd, Normalize&& normalize, Interner& interner) {
+    std::string scratch;
+    fd.ids.clear();
+    fd.line_of.clear();
+    fd.ids.reserve(fd.lines.size());
+    fd.line_of.reserve(fd.lines.size());
+    for (size_t i = 0; i < fd.lines.size(); ++i) {
+        std::string_view norm = normalize(fd.lines[i], scratch);
+        if constexpr (SkipBlank) {
+            if (is_blank_line(norm)) continue;
+        }
+        fd.ids.push_back(interner.intern(norm));
+        fd.line_of.push_back(static_cast<uint32_t>(i));
+    }
+}
+
+// Options are resolved here, once per file; the line loop is instantiated
+// for each normalizer and never tests them.
+template <typename Interner>
+static void assign_line_ids(FileData& fd, const LoadOptions& o, Interner& interner) {
+    with_bool(o.ignore_blank_lines, [&](auto skip_blank) {
+        with_line_normalizer(o, fd.path, [&](auto&& normalize) {
+            assign_line_ids<decltype(skip_blank)::value>(fd, normalize, interner);
+        });
+    });
+}
+
+// Token mode: every lexer token becomes one matching unit, tagged with the
+// line it starts on. Whitespace and comments are dropped by the lexer.
+template <typename Interner>
+static void assign_token_ids(FileData& fd, const LoadOptions& o, Interner& interner) {
+    Lexer lexer(comment_style_for(fd.path));
+    fd.ids.clear();
+    fd.line_of.clear();
+    with_bool(o.normalize_identifiers, [&](auto canonical) {
+        for (size_t i = 0; i < fd.lines.size(); ++i) {
+            lexer.lex_line(fd.lines[i], [&](std::string_view tok, TokKind kind) {
+                if constexpr (decltype(canonical)::value) fd.ids.push_back(interner.intern(canonical_token(tok, kind)));
+                else fd.ids.push_back(interner.intern(tok));
+                fd.line_of.push_back(static_cast<uint32_t>(i));
+            });
+        }
+    });
+}
+
+// Key for a run of line IDs (raw bytes of the IDs; exact, no collisions)
+static std::string ids_key(const std::vector<uint32_t>& ids, size_t i, size_t j) {
+    return std::string(reinterpret_cast<const char*>(ids.data() + i),
+                       (j - i) * sizeof(uint32_t));
+}
+
+struct Occurrence {
+    int file_index;
+    size_t start; // 0-based index into FileData::ids
+};
+
+// A repeated block: all occurrences cover `length` matching unit IDs.
+struct MaximalGroup {
+    std::vector<Occurrence> occs;
+    size_t length = 0;
+};
+
+static constexpr uint64_t kWindowBase = 0x100000001B3ULL;
+
+// Call fn(start, hash) for every window of `w` consecutive IDs, hashed with
+// a polynomial rolling hash (O(1) per window regardless of w).
+template <typename Fn>
+static void for_each_window_hash(const std::vector<uint32_t>& ids, size_t w, Fn&& fn) {
+    constexpr uint64_t B = kWindowBase;
+    if (ids.size() < w) return;
+    uint64_t Bw = 1; // B^w (mod 2^64)
+    for (size_t k = 0; k < w; ++k) Bw *= B;
+    uint64_t h = 0;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        h = h * B + mix64(ids[i]);
+        if (i >= w) h -= mix64(ids[i - w]) * Bw;
+        if (i + 1 >= w) fn(i + 1 - w, h);
+    }
+    g_stats.windows += ids.size() + 1 - w;
+}
+
+// The hash for_each_window_hash() gives the window ids[start, start + w).
+static uint64_t window_hash(const std::vector<uint32_t>& ids, size_t start, size_t w) {
+    uint64_t h = 0;
+    for (size_t k = start; k < start + w; ++k) h = h * kWindowBase + mix64(ids[k]);
+    return h;
+}
+
+// Open-addressing hash map for the hot tables (seed buckets, block contents,
+// hit keys). Entries are stored densely in insertion order; the table itself
+// is one control byte per slot (7 bits of the hash, or empty/erased) plus an
+// entry index, probed 16 slots at a time (with SSE2 where available, else
+// byte by byte). A lookup usually reads one control group and one entry
+// instead of walking separately allocated nodes. Hash(key) runs once per call
+// and is kept per entry, so growing never rehashes keys. Erasing moves the
+// last entry into the gap.
+template <typename K, typename V, typename Hash>
+class FlatHashMap {
+public:
+    using value_type = std::pair<K, V>;
+    using iterator = typename std::vector<value_type>::iterator;
+    using const_iterator = typename std::vector<value_type>::const_iterator;
+
+    size_t size() const { return entries_.size(); }
+    bool empty() const { return entries_.empty(); }
+    iterator begin() { return entries_.begin(); }
+    iterator end() { return entries_.end(); }
+    const_iterator begin() const { return entries_.begin(); }
+    const_iterator end() const { return entries_.end(); }
+
+    void clear() {
+        entries_.clear();
+        hashes_.clear();
+        std::fill(ctrl_.begin(), ctrl_.end(), kEmpty);
+        used_ = 0;
+    }
+
+    // Room for `n` entries without growing.
+    void reserve(size_t n) {
+        entries_.reserve(n);
+        hashes_.reserve(n);
+        if (n > max_used()) rehash(slots_for(n));
+    }
+
+    template <typename Key>
+    V& operator[](Key&& key) { return try_emplace(std::forward<Key>(key)).first->second; }
+
+    // The entry for `key`, value-initialized if it was absent; .second is
+    // true when it was inserted.
+    template <typename Key>
+    std::pair<iterator, bool> try_emplace(Key&& key) {
+        const uint64_t h = Hash{}(key);
+        if (size_t e = lookup(h, key); e != kNone) return { entries_.begin() + static_cast<std::ptrdiff_t>(e), false };
+        if (used_ + 1 > max_used()) rehash(slots_for(entries_.size() + 1));
+        const size_t slot = free_slot(h);
+        if (ctrl_[slot] == kEmpty) ++used_;
+        ctrl_[slot] = tag(h);
+        slot_entry_[slot] = static_cast<uint32_t>(entries_.size());
+        entries_.emplace_back(std::forward<Key>(key), V{});
+        hashes_.push_back(h);
+        return { entries_.end() - 1, true };
+    }
+
+    iterator find(const K& key) {
+        const size_t e = lookup(Hash{}(key), key);
+        return e == kNone ? end() : begin() + static_cast<std::ptrdiff_t>(e);
+    }
+    const_iterator find(const K& key) const {
+        const size_t e = lookup(Hash{}(key), key);
+        return e == kNone ? end() : begin() + static_cast<std::ptrdiff_t>(e);
+    }
+
+    // Invalidates `it` and iterators to the last entry, which takes its place.
+    void erase(iterator it) {
+        const size_t e = static_cast<size_t>(it - entries_.begin());
+        const size_t last = entries_.size() - 1;
+        ctrl_[slot_of(e)] = kErased;
+        if (e != last) {
+            slot_entry_[slot_of(last)] = static_cast<uint32_t>(e);
+            entries_[e] = std::move(entries_[last]);
+            hashes_[e] = hashes_[last];
+        }
+        entries_.pop_back();
+        hashes_.pop_back();
+    }
+
+private:
+    static constexpr size_t kGroup = 16;
+    static constexpr uint8_t kEmpty = 0x80, kErased = 0xFE; // full slots hold 0..127
+    static constexpr size_t kNone = static_cast<size_t>(-1);
+    static constexpr size_t kNextGroup = static_cast<size_t>(-2);
+
+    // Low bits of the hash pick the group, the top 7 bits are the tag.
+    static uint8_t tag(uint64_t h) { return static_cast<uint8_t>(h >> 57); }
+    size_t group_mask() const { return ctrl_.size() / kGroup - 1; }
+    // Full and erased slots together stay under 7/8 of the table, so every
+    // probe sequence reaches an empty slot.
+    size_t max_used() const { return ctrl_.size() / 8 * 7; }
+    static size_t slots_for(size_t n) {
+        size_t slots = kGroup;
+        while (slots / 8 * 7 < n) slots *= 2;
+        return slots;
+    }
+
+    // Bit i is set where control byte i of group g equals `byte`.
+    unsigned match(size_t g, uint8_t byte) const {
+        const uint8_t* c = ctrl_.data() + g * kGroup;
+#if defined(__SSE2__)
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(c));
+        return static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_set1_epi8(static_cast<char>(byte)))));
+#else
+        unsigned m = 0;
+        for (size_t i = 0; i < kGroup; ++i) m |= static_cast<unsigned>(c[i] == byte) << i;
+        return m;
+#endif
+    }
+
+    // Bit i is set where slot i of group g is empty or erased (high bit).
+    unsigned match_free(size_t g) const {
+        const uint8_t* c = ctrl_.data() + g * kGroup;
+#if defined(__SSE2__)
+        return static_cast<unsigned>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(c))));
+#else
+        unsigned m = 0;
+        for (size_t i = 0; i < kGroup; ++i) m |= static_cast<unsigned>(c[i] >> 7) << i;
+        return m;
+#endif
+    }
+
+    // Calls fn(group) along the probe sequence of `h` until
+    // it returns something other than kNextGroup. Groups are probed
+    // triangularly (g, g+1, g+3, ...), which visits every group of a
+    // power-of-two table.
+    template <typename Fn>
+    size_t probe(uint64_t h, Fn&& fn) const {
+        const size_t mask = group_mask();
+        for (size_t g = h & mask, step = 0;; g = (g + ++step) & mask) {
+            if (size_t r = fn(g); r != kNextGroup) return r;
+        }
+    }
+
+    // Index of the entry for `key`, or kNone.
+    size_t lookup(uint64_t h, const K& key) const {
+        if (ctrl_.empty()) return kNone;
+        const uint8_t want = tag(h);
+        return probe(h, [&](size_t g) {
+            for (unsigned m = match(g, want); m; m &= m - 1) {
+                const size_t e = slot_entry_[g * kGroup + static_cast<size_t>(std::countr_zero(m))];
+                if (hashes_[e] == h && entries_[e].first == key) return e;
+            }
+            return match(g, kEmpty) ? kNone : kNextGroup;
+        });
+    }
+
+    // First empty or erased slot on the probe sequence of `h`.
+    size_t free_slot(uint64_t h) const {
+        return probe(h, [&](size_t g) {
+            const unsigned m = match_free(g);
+            return m ? g * kGroup + static_cast<size_t>(std::countr_zero(m)) : kNextGroup;
+        });
+    }
+
+    // The slot that holds entry `e`.
+    size_t slot_of(size_t e) const {
+        const uint8_t want = tag(hashes_[e]);
+        return probe(hashes_[e], [&](size_t g) {
+            for (unsigned m = match(g, want); m; m &= m - 1) {
+                const size_t slot = g * kGroup + static_cast<size_t>(std::countr_zero(m));
+                if (slot_entry_[slot] == e) return slot;
+            }
+            return kNextGroup;
+        });
+    }
+
+    void rehash(size_t slots) {
+        ctrl_.assign(slots, kEmpty);
+        slot_entry_.assign(slots, 0);
+        for (size_t e = 0; e < entries_.size(); ++e) {
+            const size_t slot = free_slot(hashes_[e]);
+            ctrl_[slot] = tag(hashes_[e]);
+            slot_entry_[slot] = static_cast<uint32_t>(e);
+        }
+        used_ = entries_.size();
+    }
+
+    std::vector<value_type> entries_;
+    std::vector<uint64_t> hashes_;     // by entry
+    std::vector<uint8_t> ctrl_;        // by slot
+    std::vector<uint32_t> slot_entry_; // by slot: index into entries_
+    size_t used_ = 0;                  // full and erased slots
+};
+
+// For keys that are already well-mixed 64-bit hashes.
+struct IdHash {
+    uint64_t operator()(uint64_t h) const { return h; }
+};
+
+struct TextHash {
+    uint64_t operator()(std::string_view s) const { return unit_hash(s); }
+};
+
+// Window hash -> occurrences. Buckets may contain collisions;
+// split_verified() separates them.
+using SeedTable = FlatHashMap<uint64_t, std::vector<Occurrence>, IdHash>;
+
+// Number of windows of `w` units in `ids`.
+static size_t window_count(const std::vector<uint32_t>& ids, size_t w) {
+    return ids.size() >= w ? ids.size() + 1 - w : 0;
+}
+
+// One window as a flat record: the seed index file and spill runs store
+// these.
+struct SeedEntry {
+    uint64_t hash;
+    uint32_t file;
+    uint32_t start;
+};
+
+static bool seed_entry_less(const SeedEntry& a, const SeedEntry& b) {
+    return std::tie(a.hash, a.file, a.start) < std::tie(b.hash, b.file, b.start);
+}
+
+// Byte-identical files (vendored copies, generated code) with the same
+// units are matched once: only the first file of each set, its
+// representative, is seeded and extended, and BlockAggregator turns every
+// hit in it into a hit in each copy. Files without units never match and
+// are left out.
+struct IdenticalFiles {
+    std::vector<std::vector<int>> copies; // by file index: the copies it represents
+    std::vector<char> is_copy;            // by file index
+    size_t sets = 0;
+};
+
+// Files are grouped by content hash and compared, so a hash collision never
+// merges different files. With `by_units` (matching) they must have the same
+// units on the same lines; byte-identical files can differ there when the
+// comment syntax follows the extension (a.c and a.py in token mode).
+// Otherwise (the --identical-files report) their lines are compared. Null
+// when no two files are identical.
+static std::unique_ptr<IdenticalFiles> find_identical_files(const std::vector<FileData>& files, bool by_units) {
+    PhaseTimer t(Phase::Seed);
+    auto same = std::make_unique<IdenticalFiles>();
+    same->copies.resize(files.size());
+    same->is_copy.assign(files.size(), 0);
+    std::unordered_map<uint64_t, std::vector<int>> reps; // content hash -> representatives
+    for (int idx = 0; idx < static_cast<int>(files.size()); ++idx) {
+        const auto& fd = files[idx];
+        if (fd.ids.empty()) continue;
+        auto& candidates = reps[fd.content_hash];
+        auto rep = std::find_if(candidates.begin(), candidates.end(),
+                                [&](int r) {
+                                    return by_units ? files[r].ids == fd.ids && files[r].line_of == fd.line_of
+                                                    : files[r].lines == fd.lines;
+                                });
+        if (rep == candidates.end()) {
+            candidates.push_back(idx);
+            continue;
+        }
+        if (same->copies[*rep].empty()) ++same->sets;
+        same->copies[*rep].push_back(idx);
+        same->is_copy[idx] = 1;
+    }
+    if (same->sets == 0) return nullptr;
+    DLOG(LogSub::Match, 1, "identical files: " << same->sets << " set(s), "
+         << std::count(same->is_copy.begin(), same->is_copy.end(), 1) << " copies matched once");
+    return same;
+}
+
+// A periodic run: at least w + p units with a period p < w, so each of its
+// windows occurs again p units further on, overlapping itself (`}` on 10k
+// lines, generated tables). Every window of the run would be a seed
+// repeating all over it; instead the run is reported once as a periodic
+// block and the windows inside it are not seeded. Blocks that only pass
+// through a run are still extended across it.
+struct Run {
+    size_t start, end; // units [start, end)
+    size_t period;     // smallest period
+    size_t reach = 0;  // largest `end` of this and the runs before it
+};
+
+// Whether ids[a, a + p) is a power of a shorter sequence: then the whole
+// run repeats that one and lies inside its run.
+static bool repeats_shorter(const std::vector<uint32_t>& ids, size_t a, size_t p) {
+    for (size_t q = 1; q < p; ++q) {
+        if (p % q == 0 && std::equal(ids.begin() + static_cast<std::ptrdiff_t>(a + q),
+                                     ids.begin() + static_cast<std::ptrdiff_t>(a + p),
+                                     ids.begin() + static_cast<std::ptrdiff_t>(a))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Runs of one file for windows of `w` units. A run of period p is a stretch
+// where ids[i] == ids[i + p] for at least w consecutive i, so it contains
+// one of every w positions: only those anchors are compared with the next
+// w - 1 units, and a stretch is expanded from an anchor that matches.
+static std::vector<Run> find_runs(const std::vector<uint32_t>& ids, size_t w) {
+    std::vector<Run> runs;
+    const size_t n = ids.size();
+    if (w < 2 || n <= w) return runs;
+    std::vector<size_t> covered(w, 0); // by period: end of the last stretch
+    for (size_t i = w - 1; i < n; i += w) {
+        for (size_t p = 1; p < w && i + p < n; ++p) {
+            if (i < covered[p] || ids[i] != ids[i + p]) continue;
+            size_t a = i, b = i + 1;
+            while (a > 0 && ids[a - 1] == ids[a - 1 + p]) --a;
+            while (b + p < n && ids[b] == ids[b + p]) ++b;
+            covered[p] = b;
+            if (b - a >= w && !repeats_shorter(ids, a, p)) runs.push_back({ a, b + p, p });
+        }
+    }
+    return runs;
+}
+
+// Runs by file for windows of `w` units, found on first use: a query only
+// looks at the files its seeds lead to. `find` is find_runs(), or the
+// reference engine's own search.
+class Runs {
+public:
+    using Finder = std::vector<Run> (*)(const std::vector<uint32_t>& ids, size_t w);
+
+    Runs(const std::vector<FileData>& files, size_t w, Finder find = find_runs)
+        : files_(files), w_(w), find_(find), by_file_(files.size()), found_(files.size(), 0) {}
+
+    // By start, then period.
+    const std::vector<Run>& of(int file) const {
+        if (!found_[file]) {
+            auto& runs = by_file_[file];
+            runs = find_(files_[file].ids, w_);
+            std::sort(runs.begin(), runs.end(), [](const Run& a, const Run& b) {
+                return std::tie(a.start, a.period) < std::tie(b.start, b.period);
+            });
+            size_t reach = 0;
+            for (auto& r : runs) r.reach = reach = std::max(reach, r.end);
+            found_[file] = 1;
+        }
+        return by_file_[file];
+    }
+
+    // Whether the window at `start` lies inside a run of `file`.
+    bool covers(int file, size_t start) const {
+        const auto& runs = of(file);
+        auto it = std::upper_bound(runs.begin(), runs.end(), start,
+                                   [](size_t s, const Run& r) { return s < r.start; });
+        return it != runs.begin() && std::prev(it)->reach >= start + w_;
+    }
+
+private:
+    const std::vector<FileData>& files_;
+    size_t w_;
+    Finder find_;
+    mutable std::vector<std::vector<Run>> by_file_;
+    mutable std::vector<char> found_;
+};
+
+// Identical runs, wherever they are: a run is fixed by its first period of
+// units and its length, so those are the key.
+struct PeriodicRuns {
+    size_t period = 0;
+    size_t length = 0;
+    std::vector<Occurrence> occs; // run starts
+};
+using PeriodicTable = FlatHashMap<std::string, PeriodicRuns, TextHash>;
+
+static void add_run(PeriodicTable& table, const std::vector<uint32_t>& ids, int file, const Run& r) {
+    const uint64_t length = r.end - r.start;
+    std::string key(reinterpret_cast<const char*>(ids.data() + r.start), r.period * sizeof(uint32_t));
+    key.append(reinterpret_cast<const char*>(&length), sizeof(length));
+    PeriodicRuns& g = table[key];
+    g.period = r.period;
+    g.length = length;
+    g.occs.push_back({ file, r.start });
+}
+
+// One block per group of identical runs: one period of units, hit once over
+// each run. The text comes from the first run by path in a file at or after
+// `text_from` (files below it carry no text).
+static void emit_periodic_blocks(const std::vector<FileData>& files, const PeriodicTable& table, int text_from,
+                                 std::vector<DuplicateBlock>& out) {
+    std::vector<std::pair<Hit, Occurrence>> hits;
+    for (const auto& [key, g] : table) {
+        hits.clear();
+        for (const auto& o : g.occs) {
+            const auto& fd = files[o.file_index];
+            hits.push_back({ { to_generic_string(fd.path), fd.line_of[o.start] + 1,
+                               fd.line_of[o.start + g.length - 1] + 1 }, o });
+        }
+        std::sort(hits.begin(), hits.end(), [](const auto& a, const auto& b) {
+            return std::tie(a.first.path, a.first.start_line) < std::tie(b.first.path, b.first.start_line);
+        });
+        DuplicateBlock b;
+        b.period = g.period;
+        b.repeats = g.length / g.period;
+        bool has_text = false;
+        for (auto& [h, o] : hits) {
+            if (!has_text && o.file_index >= text_from) {
+                const auto& fd = files[o.file_index];
+                b.lines = fd.lines.slice(fd.line_of[o.start], fd.line_of[o.start + g.period - 1] + 1);
+                has_text = true;
+            }
+            b.hits.push_back(std::move(h));
+        }
+        out.push_back(std::move(b));
+    }
+}
+
+// The runs of files[first, last) as periodic blocks, identical runs merged.
+static void add_periodic_blocks(const std::vector<FileData>& files, const Runs& runs, int first, int last,
+                                std::vector<DuplicateBlock>& out) {
+    PeriodicTable table;
+    for (int idx = first; idx < last; ++idx) {
+        for (const auto& r : runs.of(idx)) add_run(table, files[idx].ids, idx, r);
+    }
+    emit_periodic_blocks(files, table, 0, out);
+}
+
+// Bucket every window of `w` IDs by hash; copies in `same` and windows
+// inside `runs` are skipped.
+static SeedTable collect_seeds(const std::vector<FileData>& files, size_t w,
+                               const IdenticalFiles* same = nullptr, const Runs* runs = nullptr) {
+    SeedTable seeds;
+    size_t windows = 0;
+    for (int idx = 0; idx < static_cast<int>(files.size()); ++idx) {
+        if (!(same && same->is_copy[idx])) windows += window_count(files[idx].ids, w);
+    }
+    seeds.reserve(windows);
+    for (int idx = 0; idx < static_cast<int>(files.size()); ++idx) {
+        if (same && same->is_copy[idx]) continue;
+        for_each_window_hash(files[idx].ids, w, [&](size_t start, uint64_t h) {
+            if (!(runs && runs->covers(idx, start))) seeds[h].push_back({ idx, start });
+        });
+    }
+    return seeds;
+}
+
+static inline bool same_window(const std::vector<FileData>& files,
+                               const Occurrence& a, const Occurrence& b, size_t w) {
+    const uint32_t* pa = files[a.file_index].ids.data() + a.start;
+    const uint32_t* pb = files[b.file_index].ids.data() + b.start;
+    return std::equal(pa, pa + w, pb);
+}
+
+// Split a hash bucket into groups (>= 2 occurrences) whose windows are truly
+// identical. Collisions are rare, so this is usually one pass comparing
+// against the first entry. Windows found only once go to `singles`, if given.
+static void split_verified(const std::vector<FileData>& files, std::vector<Occurrence> occs,
+                           size_t w, std::vector<std::vector<Occurrence>>& out,
+                           std::vector<Occurrence>* singles = nullptr) {
+    while (occs.size() >= 2) {
+        std::vector<Occurrence> same, rest;
+        same.push_back(occs[0]);
+        for (size_t i = 1; i < occs.size(); ++i) {
+            if (same_window(files, occs[0], occs[i], w)) same.push_back(occs[i]);
+            else rest.push_back(occs[i]);
+        }
+        if (same.size() >= 2) {
+            out.push_back(std::move(same));
+            ++g_stats.candidate_groups;
+        } else if (singles) {
+            singles->push_back(same[0]);
+        }
+        occs = std::move(rest);
+    }
+    if (singles && occs.size() == 1) singles->push_back(occs[0]);
+}
+
+// Extension by partition refinement, like walking a trie of what follows
+// the seed. A node is a set of occurrences that agree on `length` units; it
+// follows the next unit while they all agree. Where they diverge, or one
+// reaches the end of its file, the node is a block, and each subset that
+// shares its next unit continues as a child. So when 8 of 10 occurrences
+// share a longer block, that block is found here, not only if some other
+// seed happens to isolate those 8.
+//
+// A node whose occurrences all have the same previous unit is dropped with
+// everything below it: the same blocks, one unit longer, are found from the
+// seed one unit back. Each maximal repeat (no common previous or next unit
+// among all its occurrences, at least `w` units) is therefore reported once,
+// from its first window. When that window lies inside a run at some
+// occurrence it is not a seed, so the block is reported from the first
+// window after it that is, extended back over the units they share. A child
+// whose occurrences overlap is not followed either: for self-repeats with a
+// period of at least `w`, every step would peel off just the last
+// occurrence. Only nodes for which keep(occs) holds are followed.
+// With `same`, a single occurrence in a file with copies is a repeat too.
+template <typename Keep>
+static void refine_group(const std::vector<FileData>& files, std::vector<Occurrence> occs, size_t w,
+                         const IdenticalFiles* same, const Runs* runs, Keep&& keep,
+                         std::vector<MaximalGroup>& out) {
+    constexpr size_t npos = static_cast<size_t>(-1);
+    // Units the block extends to the left of the node, or npos when a seed
+    // further left reports it.
+    auto lead = [&](const std::vector<Occurrence>& s) {
+        const auto& f0 = files[s[0].file_index];
+        for (size_t k = 1;; ++k) {
+            for (const auto& o : s) {
+                if (o.start < k || files[o.file_index].ids[o.start - k] != f0.ids[s[0].start - k]) return k - 1;
+            }
+            if (!runs || std::none_of(s.begin(), s.end(), [&](const Occurrence& o) {
+                    return runs->covers(o.file_index, o.start - k);
+                })) {
+                return npos;
+            }
+        }
+    };
+    auto worth = [&](const std::vector<Occurrence>& s, size_t& back) {
+        if (s.size() < 2 && !(same && s.size() == 1 && !same->copies[s[0].file_index].empty())) return false;
+        back = lead(s);
+        return back != npos && keep(s);
+    };
+    // Occurrences in (file, start) order.
+    auto overlaps = [](const std::vector<Occurrence>& s, size_t length) {
+        for (size_t i = 1; i < s.size(); ++i) {
+            if (s[i].file_index == s[i - 1].file_index && s[i].start < s[i - 1].start + length) return true;
+        }
+        return false;
+    };
+    struct Node {
+        MaximalGroup g;
+        size_t back;
+    };
+    std::vector<Node> stack;
+    size_t back = 0;
+    if (!worth(occs, back)) return;
+    std::sort(occs.begin(), occs.end(), [](const Occurrence& a, const Occurrence& b) {
+        return std::tie(a.file_index, a.start) < std::tie(b.file_index, b.start);
+    });
+    stack.push_back({ { std::move(occs), w }, back });
+    std::vector<std::pair<uint32_t, Occurrence>> next; // (next unit, occurrence)
+    while (!stack.empty()) {
+        Node node = std::move(stack.back());
+        stack.pop_back();
+        MaximalGroup& g = node.g;
+        const auto& f0 = files[g.occs[0].file_index];
+        while (g.occs[0].start + g.length < f0.ids.size()) {
+            const uint32_t ref = f0.ids[g.occs[0].start + g.length];
+            bool all_ok = true;
+            for (size_t i = 1; i < g.occs.size() && all_ok; ++i) {
+                const auto& fi = files[g.occs[i].file_index];
+                const size_t at = g.occs[i].start + g.length;
+                all_ok = at < fi.ids.size() && fi.ids[at] == ref;
+            }
+            if (!all_ok) break;
+            g.length += 1;
+        }
+        next.clear();
+        for (const auto& o : g.occs) {
+            const auto& fd = files[o.file_index];
+            if (o.start + g.length < fd.ids.size()) next.push_back({ fd.ids[o.start + g.length], o });
+        }
+        std::sort(next.begin(), next.end(), [](const auto& a, const auto& b) {
+            return std::tie(a.first, a.second.file_index, a.second.start) <
+                   std::tie(b.first, b.second.file_index, b.second.start);
+        });
+        for (size_t i = 0, j; i < next.size(); i = j) {
+            std::vector<Occurrence> child;
+            for (j = i; j < next.size() && next[j].first == next[i].first; ++j) child.push_back(next[j].second);
+            if (!overlaps(child, g.length + 1) && worth(child, back)) {
+                stack.push_back({ { std::move(child), g.length + 1 }, back });
+            }
+        }
+        for (auto& o : g.occs) o.start -= node.back;
+        g.length += node.back;
+        out.push_back(std::move(g));
+    }
+}
+
+// --memory-limit: when the seed table would not fit, windows are written as
+// sorted runs of SeedEntry to anonymous temporary files and k-way merged, so
+// only the current hash group is held in memory.
+
+// Approximate cost of one window in a SeedTable reserved for every window:
+// entry and its hash, control byte and index of about two slots, and the
+// occurrence vector.
+static constexpr size_t kSeedTableBytesPerWindow = 80;
+
+class SeedSpill {
+public:
+    // Runs are sorted in a buffer of about `budget` bytes.
+    explicit SeedSpill(size_t budget)
+        : capacity_(std::max<size_t>(4096, budget / sizeof(SeedEntry))) {
+        buf_.reserve(capacity_);
+    }
+
+    void add(const SeedEntry& e) {
+        buf_.push_back(e);
+        if (buf_.size() == capacity_) flush();
+    }
+
+    size_t runs() const { return runs_.size(); }
+
+    // Call fn(bucket) for every hash, in hash order; a bucket lists its
+    // occurrences by (file, start).
+    template <typename Fn>
+    void for_each_group(Fn&& fn) {
+        flush();
+        buf_ = std::vector<SeedEntry>(); // the readers share the budget instead
+        std::vector<Reader> readers(runs_.size());
+        const size_t chunk = std::max<size_t>(1024, capacity_ / std::max<size_t>(1, runs_.size()));
+        using Head = std::pair<SeedEntry, size_t>; // (entry, run)
+        auto greater = [](const Head& a, const Head& b) { return seed_entry_less(b.first, a.first); };
+        std::priority_queue<Head, std::vector<Head>, decltype(greater)> heap(greater);
+        for (size_t r = 0; r < runs_.size(); ++r) {
+            readers[r].file = runs_[r].get();
+            std::rewind(readers[r].file);
+            SeedEntry e;
+            if (readers[r].next(e, chunk)) heap.push({ e, r });
+        }
+        std::vector<Occurrence> bucket;
+        uint64_t hash = 0;
+        auto emit = [&] {
+            if (!bucket.empty()) fn(bucket);
+            bucket.clear();
+        };
+        while (!heap.empty()) {
+            auto [e, r] = heap.top();
+            heap.pop();
+            if (e.hash != hash) {
+                emit();
+                hash = e.hash;
+            }
+            bucket.push_back({ static_cast<int>(e.file), e.start });
+            if (readers[r].next(e, chunk)) heap.push({ e, r });
+        }
+        emit();
+    }
+
+private:
+    struct Closer {
+        void operator()(std::FILE* f) const { std::fclose(f); }
+    };
+    struct Reader {
+        std::FILE* file = nullptr;
+        std::vector<SeedEntry> buf;
+        size_t pos = 0;
+
+        bool next(SeedEntry& e, size_t chunk) {
+            if (pos == buf.size()) {
+                PhaseTimer t(Phase::Seed);
+                buf.resize(chunk);
+                buf.resize(std::fread(buf.data(), sizeof(SeedEntry), chunk, file));
+                pos = 0;
+                if (buf.empty()) return false;
+            }
+            e = buf[pos++];
+            return true;
+        }
+    };
+
+    void flush() {
+        if (buf_.empty()) return;
+        std::sort(buf_.begin(), buf_.end(), seed_entry_less);
+        std::unique_ptr<std::FILE, Closer> f(std::tmpfile());
+        if (!f || std::fwrite(buf_.data(), sizeof(SeedEntry), buf_.size(), f.get()) != buf_.size() ||
+            std::fflush(f.get()) != 0) {
+            throw std::runtime_error("cannot write seed spill file for --memory-limit");
+        }
+        runs_.push_back(std::move(f));
+        buf_.clear();
+    }
+
+    size_t capacity_;
+    std::vector<SeedEntry> buf_;
+    std::vector<std::unique_ptr<std::FILE, Closer>> runs_;
+};
+
+// `dryfinder shard`: the verified seed groups one shard extends. A group
+// belongs to shard hash(window text) % count; the hash uses unit text, not
+// IDs, so every process agrees however its interner numbered the units.
+struct ShardFilter {
+    unsigned index = 0;
+    unsigned count = 1;
+    std::vector<std::string_view> units; // interned text by ID
+    std::vector<uint64_t> hashes;        // fnv1a64() of each unit, by ID
+
+    ShardFilter(unsigned index, unsigned count, std::vector<std::string_view> by_id)
+        : index(index), count(count), units(std::move(by_id)) {
+        hashes.reserve(units.size());
+        for (auto u : units) hashes.push_back(fnv1a64(u));
+    }
+
+    bool keeps(const std::vector<FileData>& files, const Occurrence& o, size_t w) const {
+        const auto& ids = files[o.file_index].ids;
+        uint64_t h = 0;
+        for (size_t i = o.start; i < o.start + w; ++i) h = mix64(h + hashes[ids[i]]);
+        return h % count == index;
+    }
+};
+
+// Seed engine: hash all windows of `w` IDs, verify the buckets and refine
+// every candidate group into its blocks, handing each one to `fn`. `live`
+// is the corpus' seed table when it was kept for this window; it was filled
+// while loading, so nothing is hashed here. Without one, a table larger
+// than opts.memory_limit is replaced by sorted runs on disk. With `shard`,
+// groups of other shards are dropped before extension. With `same`, only
+// representatives are matched; a window found once among them still
+// repeats through the copies. Windows inside `runs` are never seeds.
+template <typename Fn>
+static size_t seed_engine_groups(const std::vector<FileData>& files, size_t w, const MatchOptions& opts,
+                                 const SeedTable* live, const ShardFilter* shard,
+                                 const IdenticalFiles* same, const Runs& runs, Fn&& fn) {
+    size_t groups_built = 0;
+    std::vector<std::vector<Occurrence>> verified;
+    std::vector<Occurrence> singles, reps;
+    std::vector<MaximalGroup> groups;
+    auto all = [](const std::vector<Occurrence>&) { return true; };
+    auto extend = [&](const std::vector<Occurrence>& bucket_in) {
+        const std::vector<Occurrence>* bucket = &bucket_in;
+        verified.clear();
+        singles.clear();
+        {
+            PhaseTimer t(Phase::Seed);
+            if (live) {
+                // The live table also holds the copies' windows and those
+                // inside runs.
+                reps.clear();
+                for (const auto& o : bucket_in) {
+                    if (!(same && same->is_copy[o.file_index]) && !runs.covers(o.file_index, o.start))
+                        reps.push_back(o);
+                }
+                bucket = &reps;
+            }
+            if (bucket->size() >= 2) split_verified(files, *bucket, w, verified, same ? &singles : nullptr);
+            else if (same && bucket->size() == 1) singles.push_back(bucket->front());
+        }
+        // Only a file's first window, or the first after a run, can start
+        // a block of a single file and its copies.
+        for (const auto& o : singles) {
+            if ((o.start == 0 || runs.covers(o.file_index, o.start - 1)) && !same->copies[o.file_index].empty())
+                verified.push_back({ o });
+        }
+        for (auto& occs : verified) {
+            if (shard && !shard->keeps(files, occs[0], w)) continue;
+            groups.clear();
+            {
+                PhaseTimer t(Phase::Extend);
+                refine_group(files, std::move(occs), w, same, &runs, all, groups);
+            }
+            PhaseTimer t(Phase::Aggregate);
+            for (auto& g : groups) fn(std::move(g));
+            groups_built += groups.size();
+        }
+    };
+
+    if (!live && opts.memory_limit != 0) {
+        size_t windows = 0;
+        for (size_t idx = 0; idx < files.size(); ++idx) {
+            const auto& f = files[idx];
+            if (f.ids.size() >= w && !(same && same->is_copy[idx])) windows += f.ids.size() + 1 - w;
+        }
+        if (windows > opts.memory_limit / kSeedTableBytesPerWindow) {
+            SeedSpill spill(opts.memory_limit / 2);
+            {
+                PhaseTimer t(Phase::Seed);
+                for (uint32_t idx = 0; idx < files.size(); ++idx) {
+                    if (same && same->is_copy[idx]) continue;
+                    for_each_window_hash(files[idx].ids, w, [&](size_t start, uint64_t h) {
+                        if (!runs.covers(static_cast<int>(idx), start)) spill.add({ h, idx, static_cast<uint32_t>(start) });
+                    });
+                }
+            }
+            DLOG(LogSub::Match, 1, "seed windows (w=" << w << "): " << windows << " spilled in "
+                 << spill.runs() << " sorted runs");
+            spill.for_each_group(extend);
+            return groups_built;
+        }
+    }
+
+    SeedTable built;
+    if (!live) {
+        PhaseTimer t(Phase::Seed);
+        built = collect_seeds(files, w, same, &runs);
+    }
+    const SeedTable& seeds = live ? *live : built;
+
+    size_t candidate_seeds = 0;
+    for (const auto& kv : seeds) if (kv.second.size() >= 2) ++candidate_seeds;
+    DLOG(LogSub::Match, 1, "seed windows (w=" << w << "): " << seeds.size()
+         << " | candidate seeds (>=2 hits): " << candidate_seeds);
+
+    for (const auto& [hash, bucket] : seeds) {
+        if (same || bucket.size() >= 2) extend(bucket);
+    }
+    return groups_built;
+}
+
+// ------------------------- Reference Engine --------------------------
+// --engine=reference: the straightforward algorithm, kept deliberately
+// simple and unoptimized as the oracle that faster engines are tested
+// against (tests/differential.cpp). Windows are keyed by their exact ID
+// sequence in an ordered map and every group is extended one unit at a
+// time, splitting where its occurrences disagree. Do not optimize this code.
+
+// Runs: for every period p < w, each t whose window equals the one at t + p
+// makes [t, t + p + w) periodic, and consecutive such t form one run. A run
+// inside one with a shorter period is not reported.
+static std::vector<Run> reference_runs(const std::vector<uint32_t>& ids, size_t w) {
+    std::vector<Run> all;
+    for (size_t p = 1; p < w; ++p) {
+        for (size_t t = 0; t + p + w <= ids.size(); ++t) {
+            if (!std::equal(ids.begin() + static_cast<std::ptrdiff_t>(t),
+                            ids.begin() + static_cast<std::ptrdiff_t>(t + w),
+                            ids.begin() + static_cast<std::ptrdiff_t>(t + p))) {
+                continue;
+            }
+            if (!all.empty() && all.back().period == p && all.back().end == t + p + w - 1) all.back().end += 1;
+            else all.push_back({ t, t + p + w, p });
+        }
+    }
+    std::vector<Run> runs;
+    for (const auto& r : all) {
+        bool inside = false;
+        for (const auto& o : all) inside |= o.period < r.period && o.start <= r.start && r.end <= o.end;
+        if (!inside) runs.push_back(r);
+    }
+    return runs;
+}
+
+template <typename Fn>
+static size_t reference_engine_groups(const std::vector<FileData>& files, size_t w, const Runs& runs, Fn&& fn) {
+    auto in_run = [&](int file, size_t start) {
+        for (const auto& r : runs.of(file)) {
+            if (r.start <= start && start + w <= r.end) return true;
+        }
+        return false;
+    };
+    std::map<std::vector<uint32_t>, std::vector<Occurrence>> seeds;
+    {
+        PhaseTimer t(Phase::Seed);
+        for (int idx = 0; idx < static_cast<int>(files.size()); ++idx) {
+            const auto& ids = files[idx].ids;
+            for (size_t i = 0; i + w <= ids.size(); ++i) {
+                if (in_run(idx, i)) continue;
+                std::vector<uint32_t> key(ids.begin() + static_cast<std::ptrdiff_t>(i),
+                                          ids.begin() + static_cast<std::ptrdiff_t>(i + w));
+                seeds[key].push_back({ idx, i });
+            }
+        }
+    }
+    DLOG(LogSub::Match, 1, "reference seed windows (w=" << w << "): " << seeds.size());
+
+    auto unit = [&](const Occurrence& o, size_t k) { return files[o.file_index].ids[k]; };
+    auto size_of = [&](const Occurrence& o) { return files[o.file_index].ids.size(); };
+
+    // Each seed group is split like a trie: a node follows the next unit
+    // while all its occurrences agree and stops where they do not; every
+    // set of at least two occurrences sharing the next unit, none of them
+    // overlapping, continues as a new node. Nodes whose occurrences all have
+    // the same previous unit are not reported (a longer seed reports them),
+    // unless every window back to where they differ lies inside a run at
+    // some occurrence: then the node is reported, extended back that far.
+    size_t groups_built = 0;
+    for (const auto& [key, occs_in] : seeds) {
+        if (occs_in.size() < 2) continue;
+        std::vector<MaximalGroup> nodes;
+        {
+            PhaseTimer t(Phase::Extend);
+            std::vector<MaximalGroup> todo;
+            todo.push_back({ occs_in, w });
+            while (!todo.empty()) {
+                MaximalGroup g = todo.back();
+                todo.pop_back();
+                while (true) {
+                    bool ok = true;
+                    for (const auto& o : g.occs) {
+                        size_t next = o.start + g.length;
+                        size_t next0 = g.occs[0].start + g.length;
+                        if (next >= size_of(o) || next0 >= size_of(g.occs[0]) ||
+                            unit(o, next) != unit(g.occs[0], next0)) {
+                            ok = false;
+                            break;
+                        }
+                    }
+                    if (!ok) break;
+                    g.length += 1;
+                }
+                std::map<uint32_t, std::vector<Occurrence>> children;
+                for (const auto& o : g.occs) {
+                    if (o.start + g.length < size_of(o)) children[unit(o, o.start + g.length)].push_back(o);
+                }
+                for (const auto& [next, occs] : children) {
+                    bool overlap = false;
+                    for (const auto& a : occs) {
+                        for (const auto& b : occs) {
+                            overlap |= a.file_index == b.file_index && a.start < b.start &&
+                                       b.start < a.start + g.length + 1;
+                        }
+                    }
+                    if (occs.size() >= 2 && !overlap) todo.push_back({ occs, g.length + 1 });
+                }
+                size_t back = 0;
+                bool reported = true;
+                for (size_t k = 1; reported; ++k) {
+                    bool shared = true;
+                    for (const auto& o : g.occs) {
+                        if (o.start < k || g.occs[0].start < k ||
+                            unit(o, o.start - k) != unit(g.occs[0], g.occs[0].start - k)) {
+                            shared = false;
+                        }
+                    }
+                    if (!shared) break;
+                    bool seeded = true;
+                    for (const auto& o : g.occs) {
+                        if (in_run(o.file_index, o.start - k)) seeded = false;
+                    }
+                    if (seeded) reported = false;
+                    else back = k;
+                }
+                if (!reported) continue;
+                for (auto& o : g.occs) o.start -= back;
+                g.length += back;
+                nodes.push_back(std::move(g));
+            }
+        }
+        PhaseTimer t(Phase::Aggregate);
+        for (auto& g : nodes) fn(std::move(g));
+        groups_built += nodes.size();
+    }
+    return groups_built;
+}
+
+// Runs of windows of `w` units as the selected engine finds them.
+static Runs runs_for(const std::vector<FileData>& files, size_t w, const MatchOptions& opts) {
+    return Runs(files, w, opts.engine == Engine::Reference ? reference_runs : find_runs);
+}
+
+// Run the selected engine over windows of `w` units, outside `runs` (from
+// runs_for()). The reference engine ignores `same` and matches every file
+// itself.
+template <typename Fn>
+static size_t for_each_maximal_group(const std::vector<FileData>& files, size_t w, const MatchOptions& opts,
+                                     const SeedTable* live, const IdenticalFiles* same, const Runs& runs,
+                                     Fn&& fn) {
+    switch (opts.engine) {
+        case Engine::Reference: return reference_engine_groups(files, w, runs, std::forward<Fn>(fn));
+        case Engine::Seed:      break;
+    }
+    return seed_engine_groups(files, w, opts, live, nullptr, same, runs, std::forward<Fn>(fn));
+}
+
+// ------------------------- Gapped Chaining ---------------------------
+// --max-gap G: exact maximal groups act as anchors and are chained along
+// their diagonals. A chain holds a set of occurrences (start, end). A group
+// Y continues it when, for at least two chain occurrences, Y has an
+// occurrence in the same file starting at most G units after that chain
+// occurrence ends (the per-occurrence offsets stay within a band of width
+// G). Occurrences without a continuation are dropped from the chain. The gap
+// budget G is cumulative per occurrence over the whole chain.
+//
+// Successors are found through an index from every occurrence position to
+// its groups, probing the G + 1 positions after the first chain
+// occurrence, and each candidate is matched with one binary search per
+// chain occurrence. The cost is near-linear in the number of anchor hits.
+
+struct GappedChain {
+    std::vector<Occurrence> occs; // start of each occurrence
+    std::vector<size_t> ends;     // exclusive end (units) of each occurrence
+    size_t matched = 0;           // sum of exact piece lengths (units)
+    size_t pieces = 0;            // number of anchors chained
+    size_t head = 0;              // first anchor
+};
+
+static inline uint64_t pos_key(int file_index, size_t start) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(file_index)) << 32) |
+           static_cast<uint32_t>(start);
+}
+
+static inline bool occ_less(const Occurrence& a, const Occurrence& b) {
+    if (a.file_index != b.file_index) return a.file_index < b.file_index;
+    return a.start < b.start;
+}
+
+// Sort each group's occurrences by position, drop duplicate groups (the same
+// block is usually reached from several seeds) and order the groups by
+// first occurrence, longest first.
+static void dedupe_groups(std::vector<MaximalGroup>& groups) {
+    std::unordered_set<std::string> seen;
+    std::vector<MaximalGroup> out;
+    out.reserve(groups.size());
+    for (auto& g : groups) {
+        std::sort(g.occs.begin(), g.occs.end(), occ_less);
+        std::string key(reinterpret_cast<const char*>(&g.length), sizeof(g.length));
+        for (const auto& oc : g.occs) {
+            uint64_t k = pos_key(oc.file_index, oc.start);
+            key.append(reinterpret_cast<const char*>(&k), sizeof(k));
+        }
+        if (seen.insert(std::move(key)).second) out.push_back(std::move(g));
+    }
+    std::sort(out.begin(), out.end(), [](const MaximalGroup& a, const MaximalGroup& b) {
+        if (occ_less(a.occs[0], b.occs[0])) return true;
+        if (occ_less(b.occs[0], a.occs[0])) return false;
+        if (a.length != b.length) return a.length > b.length;
+        return a.occs.size() > b.occs.size();
+    });
+    groups = std::move(out);
+}
+
+static std::vector<GappedChain> chain_gapped_groups(const std::vector<MaximalGroup>& groups,
+                                                    size_t max_gap) {
+    std::unordered_map<uint64_t, std::vector<size_t>> by_pos; // occurrence start -> groups
+    for (size_t gi = 0; gi < groups.size(); ++gi) {
+        for (const auto& o : groups[gi].occs) by_pos[pos_key(o.file_index, o.start)].push_back(gi);
+    }
+
+    std::vector<char> consumed(groups.size(), 0);
+    std::vector<GappedChain> chains;
+    std::vector<size_t> used, next_used, best_used; // gap budget spent per occurrence
+    std::vector<size_t> match, best_match;          // chain occurrence -> Y occurrence (or SIZE_MAX)
+    for (size_t head = 0; head < groups.size(); ++head) {
+        if (consumed[head]) continue;
+        consumed[head] = 1;
+        const auto& H = groups[head];
+        GappedChain chain;
+        chain.occs = H.occs;
+        chain.ends.reserve(H.occs.size());
+        for (const auto& o : H.occs) chain.ends.push_back(o.start + H.length);
+        chain.matched = H.length;
+        chain.pieces = 1;
+        chain.head = head;
+        used.assign(H.occs.size(), 0);
+
+        while (true) {
+            size_t best = SIZE_MAX, best_kept = 0;
+            const auto& o0 = chain.occs[0];
+            for (size_t d = 0; d + used[0] <= max_gap; ++d) {
+                auto it = by_pos.find(pos_key(o0.file_index, chain.ends[0] + d));
+                if (it == by_pos.end()) continue;
+                for (size_t y : it->second) {
+                    if (consumed[y]) continue;
+                    const auto& Y = groups[y];
+                    size_t kept = 0, prev = SIZE_MAX;
+                    match.assign(chain.occs.size(), SIZE_MAX);
+                    next_used = used;
+                    for (size_t i = 0; i < chain.occs.size(); ++i) {
+                        Occurrence probe{ chain.occs[i].file_index, chain.ends[i] };
+                        auto yo = std::lower_bound(Y.occs.begin(), Y.occs.end(), probe, occ_less);
+                        if (yo == Y.occs.end() || yo->file_index != probe.file_index) continue;
+                        size_t gap = yo->start - chain.ends[i];
+                        size_t yi = static_cast<size_t>(yo - Y.occs.begin());
+                        if (gap + used[i] > max_gap || (prev != SIZE_MAX && yi <= prev)) continue;
+                        match[i] = yi;
+                        next_used[i] += gap;
+                        prev = yi;
+                        ++kept;
+                    }
+                    // Prefer the successor that keeps most occurrences, then the
+                    // smallest gap (probe order), then the longest piece.
+                    if (kept >= 2 && match[0] != SIZE_MAX &&
+                        (kept > best_kept ||
+                         (kept == best_kept && Y.length > groups[best].length))) {
+                        best = y;
+                        best_kept = kept;
+                        best_match = match;
+                        best_used = next_used;
+                    }
+                }
+                if (best != SIZE_MAX) break;
+            }
+            if (best == SIZE_MAX) break;
+
+            const auto& Y = groups[best];
+            GappedChain next;
+            next.matched = chain.matched + Y.length;
+            next.pieces = chain.pieces + 1;
+            next.head = head;
+            std::vector<size_t> kept_used;
+            for (size_t i = 0; i < chain.occs.size(); ++i) {
+                if (best_match[i] == SIZE_MAX) continue;
+                next.occs.push_back(chain.occs[i]);
+                next.ends.push_back(Y.occs[best_match[i]].start + Y.length);
+                kept_used.push_back(best_used[i]);
+            }
+            // A successor is absorbed only if the chain used all of its
+            // occurrences; otherwise it is still reported on its own.
+            if (best_kept == Y.occs.size()) consumed[best] = 1;
+            chain = std::move(next);
+            used = std::move(kept_used);
+        }
+        chains.push_back(std::move(chain));
+    }
+    return chains;
+}
+
+// A block of one shard: hits may be fewer than two until shards are merged.
+struct PartialBlock {
+    std::string key;      // normalized content
+    DuplicateBlock block; // lines come from hits[text_hit]
+    size_t text_hit = 0;
+};
+
+// Aggregates maximal blocks keyed by normalized content (unit IDs) to
+// dedupe/merge hits. The displayed text is taken from the hit that sorts
+// first by (path, start_line), so the output does not depend on the order in
+// which seeds are visited. Files below `text_from` carry no text (indexed
+// files in query mode) and never provide it.
+class BlockAggregator {
+public:
+    // With `same`, groups come from representatives only and each of their
+    // hits is repeated for every copy.
+    explicit BlockAggregator(const std::vector<FileData>& files, int text_from = 0,
+                             const IdenticalFiles* same = nullptr)
+        : files_(files), text_from_(text_from), same_(same), path_id_(files.size(), kNoPath) {}
+
+    void add(const MaximalGroup& g) {
+        const auto& f0 = files_[g.occs[0].file_index];
+        auto& agg = by_content_[ids_key(f0.ids, g.occs[0].start, g.occs[0].start + g.length)];
+
+        for (const auto& oc : g.occs) {
+            const auto& fd = files_[oc.file_index];
+            const size_t start_line = fd.line_of[oc.start] + 1;                // 1-based
+            const size_t end_line   = fd.line_of[oc.start + g.length - 1] + 1; // 1-based inclusive
+            add_hit(agg, oc.file_index, start_line, end_line);
+            if (!same_) continue;
+            for (int copy : same_->copies[oc.file_index]) add_hit(agg, copy, start_line, end_line);
+        }
+    }
+
+    // Append every block with >= 2 unique hits to `out`.
+    void finish(std::vector<DuplicateBlock>& out) {
+        out.reserve(out.size() + by_content_.size());
+        for (auto& [_, agg] : by_content_) {
+            if (agg.hits.size() >= 2 && agg.text_file >= 0) {
+                const auto& lines = files_[agg.text_file].lines;
+                DuplicateBlock b;
+                b.lines = lines.slice(agg.text_first, agg.text_last + 1);
+                b.hits  = std::move(agg.hits);
+                out.push_back(std::move(b));
+            }
+        }
+        by_content_.clear();
+    }
+
+    // Append every block, however few hits it has, keyed by its normalized
+    // units (joined by '\n') so blocks from other shards can be merged.
+    void finish_partial(std::vector<PartialBlock>& out, const std::vector<std::string_view>& units) {
+        out.reserve(out.size() + by_content_.size());
+        for (auto& [key, agg] : by_content_) {
+            if (agg.text_file < 0) continue;
+            PartialBlock p;
+            for (size_t i = 0; i < key.size() / sizeof(uint32_t); ++i) {
+                uint32_t id;
+                std::memcpy(&id, key.data() + i * sizeof(uint32_t), sizeof(id));
+                if (i) p.key += '\n';
+                p.key += units[id];
+            }
+            const auto& lines = files_[agg.text_file].lines;
+            p.block.lines = lines.slice(agg.text_first, agg.text_last + 1);
+            p.block.hits = std::move(agg.hits);
+            p.text_hit = agg.text_hit;
+            out.push_back(std::move(p));
+        }
+        by_content_.clear();
+    }
+
+private:
+    // A hit by path (as an id into paths_), start and end line.
+    struct HitKey {
+        uint32_t path, start, end;
+        bool operator==(const HitKey&) const = default;
+    };
+    struct HitKeyHash {
+        uint64_t operator()(const HitKey& k) const {
+            return mix64((static_cast<uint64_t>(k.path) << 32 | k.start) ^ mix64(k.end));
+        }
+    };
+
+    struct Agg {
+        FlatHashMap<HitKey, std::monostate, HitKeyHash> hit_keys;
+        std::vector<Hit> hits;
+        int text_file = -1;  // source of the displayed lines
+        size_t text_first = 0, text_last = 0; // 0-based line range in that file
+        size_t text_hit = 0; // index of that hit in `hits`
+    };
+
+    // Files with the same generic path share an id, so their hits are one.
+    uint32_t path_id(int file_index) {
+        uint32_t& id = path_id_[file_index];
+        if (id == kNoPath) {
+            auto [it, added] = ids_by_path_.try_emplace(to_generic_string(files_[file_index].path));
+            if (added) {
+                it->second = static_cast<uint32_t>(paths_.size());
+                paths_.push_back(it->first);
+            }
+            id = it->second;
+        }
+        return id;
+    }
+
+    void add_hit(Agg& agg, int file_index, size_t start_line, size_t end_line) {
+        const uint32_t path = path_id(file_index);
+        const HitKey key{ path, static_cast<uint32_t>(start_line), static_cast<uint32_t>(end_line) };
+        if (!agg.hit_keys.try_emplace(key).second) return;
+        Hit h;
+        h.path = paths_[path];
+        h.start_line = start_line;
+        h.end_line = end_line;
+        bool first = file_index >= text_from_ && agg.text_file < 0;
+        if (file_index >= text_from_ && !first) {
+            const std::string& cur = paths_[path_id(agg.text_file)];
+            first = h.path < cur || (h.path == cur && h.start_line - 1 < agg.text_first);
+        }
+        if (first) {
+            agg.text_file  = file_index;
+            agg.text_first = h.start_line - 1;
+            agg.text_last  = h.end_line - 1;
+            agg.text_hit   = agg.hits.size();
+        }
+        agg.hits.push_back(std::move(h));
+    }
+
+    const std::vector<FileData>& files_;
+    int text_from_;
+    const IdenticalFiles* same_;
+    static constexpr uint32_t kNoPath = static_cast<uint32_t>(-1);
+    std::vector<uint32_t> path_id_;                       // by file index, filled on first hit
+    std::unordered_map<std::string, uint32_t> ids_by_path_;
+    std::vector<std::string> paths_;                      // by path id
+    FlatHashMap<std::string, Agg, TextHash> by_content_;  // content key -> Agg
+};
+
+static std::vector<DuplicateBlock>
+find_repeated_blocks(const std::vector<FileData>& files, const LoadOptions& lo, const MatchOptions& opts,
+                     const SeedTable* live, size_t live_window) {
+    const bool tokens = lo.granularity == Granularity::Tokens;
+    const size_t window = tokens ? opts.min_tokens : opts.min_lines;
+    auto live_for = [&](size_t w) { return w == live_window ? live : nullptr; };
+
+    DLOG(LogSub::Match, 1, "building maximal groups with "
+         << (tokens ? "min_tokens=" : "min_lines=") << window
+         << (lo.ignore_indent ? " [ignore-indentation]" : "")
+         << (lo.ignore_trailing_ws ? " [ignore-trailing-whitespace]" : "")
+         << (lo.collapse_ws ? " [collapse-whitespace]" : "")
+         << (lo.ignore_blank_lines ? " [ignore-blank-lines]" : "")
+         << (lo.normalize_identifiers ? " [normalize-identifiers]" : "")
+         << (opts.max_gap ? " [max-gap=" + std::to_string(opts.max_gap) + "]" : ""));
+
+    // Gapped chaining reports occurrences itself, so it sees every file.
+    std::unique_ptr<IdenticalFiles> same;
+    if (opts.engine == Engine::Seed && opts.max_gap == 0) same = find_identical_files(files, true);
+
+    BlockAggregator agg(files, 0, same.get());
+    auto add_group = [&](const MaximalGroup& g) { agg.add(g); };
+
+    std::vector<DuplicateBlock> out;
+    const Runs runs = runs_for(files, window, opts);
+    size_t groups_built = 0;
+    if (opts.max_gap == 0) {
+        groups_built = for_each_maximal_group(files, window, opts, live_for(window), same.get(), runs, add_group);
+    } else {
+        // Anchors: the regular groups plus groups seeded with shorter windows,
+        // so that pieces between gaps can be shorter than the minimum. By
+        // pigeonhole, a block of `window` matching units split by at most G
+        // gaps has a piece of at least window / (G + 1) units.
+        std::vector<MaximalGroup> groups;
+        auto keep = [&](MaximalGroup&& g) { groups.push_back(std::move(g)); };
+        groups_built = for_each_maximal_group(files, window, opts, live_for(window), nullptr, runs, keep);
+        size_t anchor = std::max<size_t>(1, window / (opts.max_gap + 1));
+        if (anchor < window) {
+            groups_built += for_each_maximal_group(files, anchor, opts, live_for(anchor), nullptr,
+                                                   runs_for(files, anchor, opts), keep);
+        }
+        std::vector<GappedChain> chains;
+        {
+            PhaseTimer t(Phase::Extend);
+            dedupe_groups(groups);
+            chains = chain_gapped_groups(groups, opts.max_gap);
+        }
+        PhaseTimer t(Phase::Aggregate);
+        std::unordered_set<std::string> chain_keys;
+        size_t gapped = 0;
+        for (const auto& chain : chains) {
+            if (chain.matched < window) continue;
+            if (chain.pieces == 1) {
+                add_group(groups[chain.head]);
+                continue;
+            }
+            // Occurrences of a chain differ in content, so they are reported
+            // as-is instead of being merged by content. Occurrences are in
+            // (file, start) order, so the first one provides the text.
+            DuplicateBlock b;
+            std::string key;
+            for (size_t i = 0; i < chain.occs.size(); ++i) {
+                const auto& fd = files[chain.occs[i].file_index];
+                Hit h;
+                h.path = to_generic_string(fd.path);
+                h.start_line = fd.line_of[chain.occs[i].start] + 1;
+                h.end_line   = fd.line_of[chain.ends[i] - 1] + 1;
+                key += h.path + '\n' + std::to_string(h.start_line) + '\n' +
+                       std::to_string(h.end_line) + '\n';
+                b.hits.push_back(std::move(h));
+            }
+            if (!chain_keys.insert(key).second) continue;
+            const auto& lines = files[chain.occs[0].file_index].lines;
+            b.lines = lines.slice(b.hits[0].start_line - 1, b.hits[0].end_line);
+            out.push_back(std::move(b));
+            ++gapped;
+        }
+        DLOG(LogSub::Match, 1, "gapped chaining: anchors=" << groups.size()
+             << " chains=" << chains.size() << " gapped blocks=" << gapped);
+    }
+
+    DLOG(LogSub::Match, 1, "maximal groups built: " << groups_built);
+
+    {
+        PhaseTimer t(Phase::Aggregate);
+        agg.finish(out);
+        const size_t before = out.size();
+        add_periodic_blocks(files, runs, 0, static_cast<int>(files.size()), out);
+        DLOG(LogSub::Match, 1, "periodic runs: " << out.size() - before);
+    }
+    DLOG(LogSub::Match, 1, "final duplicate blocks: " << out.size());
+    log_flush();
+    return out;
+}
+
+static bool hit_less(const Hit& a, const Hit& b) {
+    if (a.path != b.path) return a.path < b.path;
+    if (a.start_line != b.start_line) return a.start_line < b.start_line;
+    return a.end_line < b.end_line;
+}
+
+// Sort hits by position, then blocks by size/length (lines desc), then by
+// occurrences desc, then by content.
+static void sort_blocks(std::vector<DuplicateBlock>& blocks) {
+    PhaseTimer t(Phase::Sort);
+    for (auto& b : blocks) std::sort(b.hits.begin(), b.hits.end(), hit_less);
+    std::sort(blocks.begin(), blocks.end(), [](const DuplicateBlock& a, const DuplicateBlock& b){
+        if (a.lines.size() != b.lines.size()) return a.lines.size() > b.lines.size();
+        if (a.hits.size()  != b.hits.size())  return a.hits.size()  > b.hits.size();
+        if (!a.lines.empty() && !b.lines.empty() && a.lines[0] != b.lines[0])
+            return a.lines[0] < b.lines[0];
+        if (a.lines != b.lines) return a.lines < b.lines;
+        // Equal content can still come from distinct token spans; order by
+        // hits so the output does not depend on group discovery order.
+        return std::lexicographical_compare(a.hits.begin(), a.hits.end(),
+                                            b.hits.begin(), b.hits.end(), hit_less);
+    });
+    g_stats.blocks = blocks.size();
+    DLOG(LogSub::Emit, 1, "blocks after sort: " << blocks.size());
+}
+
+// Blocks that include a window of files[first, last): every distinct window
+// hash of those files is expanded by bucket_of(hash, bucket) to all
+// occurrences with that hash, verified, and refined into the blocks that
+// touch one of the files, followed by the runs of those files (with the
+// identical runs elsewhere). Used to look a few documents up in a prebuilt
+// seed table instead of matching the whole corpus; runs are only searched in
+// the files the seeds lead to.
+template <typename BucketOf>
+static std::vector<DuplicateBlock> query_blocks(const std::vector<FileData>& files, size_t w,
+                                                int first, int last, int text_from, BucketOf&& bucket_of) {
+    const Runs runs(files, w);
+    std::vector<uint64_t> hashes;
+    {
+        PhaseTimer t(Phase::Seed);
+        for (int k = first; k < last; ++k) {
+            for_each_window_hash(files[k].ids, w, [&](size_t start, uint64_t h) {
+                if (!runs.covers(k, start)) hashes.push_back(h);
+            });
+        }
+        std::sort(hashes.begin(), hashes.end());
+        hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+    }
+
+    BlockAggregator agg(files, text_from);
+    std::vector<Occurrence> bucket;
+    std::vector<std::vector<Occurrence>> verified;
+    std::vector<MaximalGroup> groups;
+    auto touches = [&](const std::vector<Occurrence>& occs) {
+        return std::any_of(occs.begin(), occs.end(),
+                           [&](const Occurrence& o) { return o.file_index >= first && o.file_index < last; });
+    };
+    size_t groups_built = 0;
+    for (uint64_t hash : hashes) {
+        bucket.clear();
+        verified.clear();
+        {
+            PhaseTimer t(Phase::Seed);
+            bucket_of(hash, bucket);
+            bucket.erase(std::remove_if(bucket.begin(), bucket.end(), [&](const Occurrence& o) {
+                return runs.covers(o.file_index, o.start);
+            }), bucket.end());
+            split_verified(files, std::move(bucket), w, verified);
+        }
+        for (auto& occs : verified) {
+            groups.clear();
+            {
+                PhaseTimer t(Phase::Extend);
+                refine_group(files, std::move(occs), w, nullptr, &runs, touches, groups);
+            }
+            PhaseTimer t(Phase::Aggregate);
+            for (const auto& g : groups) agg.add(g);
+            groups_built += groups.size();
+        }
+    }
+    DLOG(LogSub::Match, 1, "query windows: " << hashes.size() << " | maximal groups built: " << groups_built);
+
+    std::vector<DuplicateBlock> blocks;
+    PhaseTimer t(Phase::Aggregate);
+    agg.finish(blocks);
+
+    // Identical runs elsewhere start with the same window as one of ours.
+    PeriodicTable periodic;
+    for (int k = first; k < last; ++k) {
+        for (const auto& r : runs.of(k)) add_run(periodic, files[k].ids, k, r);
+    }
+    for (auto& [key, g] : periodic) {
+        const Occurrence ours = g.occs.front();
+        const auto& ids = files[ours.file_index].ids;
+        bucket.clear();
+        bucket_of(window_hash(ids, ours.start, w), bucket);
+        for (const auto& o : bucket) {
+            if (o.file_index >= first && o.file_index < last) continue;
+            const auto& theirs = runs.of(o.file_index);
+            auto it = std::lower_bound(theirs.begin(), theirs.end(), o.start,
+                                       [](const Run& r, size_t s) { return r.start < s; });
+            for (; it != theirs.end() && it->start == o.start; ++it) {
+                if (it->period == g.period && it->end - it->start == g.length &&
+                    std::equal(ids.begin() + static_cast<std::ptrdiff_t>(ours.start),
+                               ids.begin() + static_cast<std::ptrdiff_t>(ours.start + g.period),
+                               files[o.file_index].ids.begin() + static_cast<std::ptrdiff_t>(o.start))) {
+                    g.occs.push_back(o);
+                }
+            }
+        }
+    }
+    emit_periodic_blocks(files, periodic, text_from, blocks);
+    return blocks;
+}
+
+// ------------------------------- Corpus ------------------------------
+
+struct Corpus::Impl {
+    LoadOptions opts;
+    std::vector<FileData> files;     // slots; a removed document leaves an empty one
+    std::vector<size_t> free_slots;
+    std::unordered_map<std::string, size_t> by_name; // doc_key -> slot in files
+    StringInterner interner;
+    size_t skipped_binary = 0;
+    std::string buf; // read buffer reused across files
+
+    // Optional live seed table over windows of `seed_window` units, kept up
+    // to date as documents change (0: none).
+    size_t seed_window = 0;
+    SeedTable seeds;
+
+    // A document read and interned but not yet placed in a slot. prepare()
+    // only touches the (thread-safe) interner, so loader threads run it
+    // concurrently; insert() runs on one thread.
+    struct Prepared {
+        std::string key;
+        FileData fd;
+        bool binary = false;
+        std::vector<uint64_t> hashes; // window hashes for the seed table
+    };
+
+    bool index(const fs::path& p, std::string_view text);
+    Prepared prepare(const fs::path& p, std::string_view text, bool timed);
+    bool insert(Prepared&& doc);
+    bool erase(const std::string& key);
+    void sort_slots();
+    void link_seeds(size_t slot);
+    void unlink_seeds(size_t slot);
+};
+
+// Documents are keyed by their lexically normal generic path, so "./a.c"
+// and "a.c" name the same document.
+static std::string doc_key(const fs::path& p) {
+    return to_generic_string(p.lexically_normal());
+}
+
+// Sniff `text` for binary content and turn every line (or token) once into
+// an interned ID. A document with the same name is replaced. IDs of the
+// replaced text stay in the interner; they are simply no longer referenced.
+bool Corpus::Impl::index(const fs::path& p, std::string_view text) {
+    return insert(prepare(p, text, true));
+}
+
+// `timed` is false on loader threads: their sniffing is reported as worker
+// time and the rest is load time of the pipeline as a whole.
+Corpus::Impl::Prepared Corpus::Impl::prepare(const fs::path& p, std::string_view text, bool timed) {
+    Prepared doc;
+    doc.key = doc_key(p);
+    {
+        PhaseTimer t(Phase::Sniff, timed);
+        WorkerTimer w(Phase::Sniff, !timed);
+        doc.binary = is_probably_binary(text, p, opts.binary_sniff_bytes, opts.binary_ratio);
+    }
+    g_stats.bytes_read += text.size();
+    if (doc.binary) {
+        DLOG(LogSub::Load, 2, "skip binary file: " << to_generic_string(p));
+        return doc;
+    }
+    PhaseTimer t(Phase::Load, timed);
+    FileData& fd = doc.fd;
+    fd.path = p;
+    fd.lines = split_lines_normalized(text);
+    fd.content_hash = std::hash<std::string_view>{}(text);
+    if (opts.granularity == Granularity::Tokens) assign_token_ids(fd, opts, interner);
+    else assign_line_ids(fd, opts, interner);
+    if (seed_window != 0) {
+        for_each_window_hash(fd.ids, seed_window, [&](size_t, uint64_t h) { doc.hashes.push_back(h); });
+    }
+    DLOG(LogSub::Load, 2, "read " << to_generic_string(p) << " (" << fd.lines.size()
+         << " lines, " << fd.ids.size() << " units)");
+    return doc;
+}
+
+bool Corpus::Impl::insert(Prepared&& doc) {
+    if (doc.binary) {
+        erase(doc.key);
+        ++skipped_binary;
+        ++g_stats.files_binary;
+        return false;
+    }
+    ++g_stats.files;
+    g_stats.lines += doc.fd.lines.size();
+    g_stats.units += doc.fd.ids.size();
+    auto it = by_name.find(doc.key);
+    size_t slot;
+    if (it != by_name.end()) {
+        slot = it->second;
+        unlink_seeds(slot);
+    } else if (!free_slots.empty()) {
+        slot = free_slots.back();
+        free_slots.pop_back();
+        by_name.emplace(std::move(doc.key), slot);
+    } else {
+        slot = files.size();
+        files.emplace_back();
+        by_name.emplace(std::move(doc.key), slot);
+    }
+    files[slot] = std::move(doc.fd);
+    if (seed_window != 0) {
+        for (size_t start = 0; start < doc.hashes.size(); ++start) {
+            seeds[doc.hashes[start]].push_back({ static_cast<int>(slot), start });
+        }
+    }
+    return true;
+}
+
+bool Corpus::Impl::erase(const std::string& key) {
+    auto it = by_name.find(key);
+    if (it == by_name.end()) return false;
+    const size_t slot = it->second;
+    by_name.erase(it);
+    unlink_seeds(slot);
+    files[slot] = FileData{};
+    free_slots.push_back(slot);
+    return true;
+}
+
+// Put the live documents in path order, as if they had been added from a
+// sorted file list, and drop empty slots. The seed table follows.
+void Corpus::Impl::sort_slots() {
+    std::vector<std::pair<std::string, size_t>> order; // (generic path, slot)
+    order.reserve(by_name.size());
+    for (const auto& [key, slot] : by_name) order.emplace_back(to_generic_string(files[slot].path), slot);
+    std::sort(order.begin(), order.end());
+    std::vector<int> moved_to(files.size(), -1);
+    std::vector<FileData> sorted;
+    sorted.reserve(order.size());
+    for (const auto& [path, slot] : order) {
+        moved_to[slot] = static_cast<int>(sorted.size());
+        sorted.push_back(std::move(files[slot]));
+    }
+    files = std::move(sorted);
+    free_slots.clear();
+    for (auto& [key, slot] : by_name) slot = static_cast<size_t>(moved_to[slot]);
+    for (auto& [hash, bucket] : seeds) {
+        for (auto& o : bucket) o.file_index = moved_to[o.file_index];
+        std::sort(bucket.begin(), bucket.end(), [](const Occurrence& a, const Occurrence& b) {
+            return std::tie(a.file_index, a.start) < std::tie(b.file_index, b.start);
+        });
+    }
+}
+
+void Corpus::Impl::link_seeds(size_t slot) {
+    if (seed_window == 0) return;
+    for_each_window_hash(files[slot].ids, seed_window, [&](size_t start, uint64_t h) {
+        seeds[h].push_back({ static_cast<int>(slot), start });
+    });
+}
+
+void Corpus::Impl::unlink_seeds(size_t slot) {
+    if (seed_window == 0) return;
+    for_each_window_hash(files[slot].ids, seed_window, [&](size_t, uint64_t h) {
+        auto it = seeds.find(h);
+        if (it == seeds.end()) return;
+        auto& bucket = it->second;
+        bucket.erase(std::remove_if(bucket.begin(), bucket.end(),
+                                    [&](const Occurrence& o) { return o.file_index == static_cast<int>(slot); }),
+                     bucket.end());
+        if (bucket.empty()) seeds.erase(it);
+    });
+}
+
+Corpus::Corpus(const LoadOptions& opts) : impl_(std::make_unique<Impl>()) {
+    impl_->opts = opts;
+}
+
+Corpus::~Corpus() = default;
+Corpus::Corpus(Corpus&&) noexcept = default;
+Corpus& Corpus::operator=(Corpus&&) noexcept = default;
+
+const LoadOptions& Corpus::options() const {
+    return impl_->opts;
+}
+
+size_t Corpus::file_count() const {
+    return impl_->by_name.size();
+}
+
+// Load a file with one read and index the loaded buffer.
+bool Corpus::add_file(const fs::path& p) {
+    {
+        PhaseTimer t(Phase::Load);
+        read_file_bytes(p, impl_->buf, &impl_->opts);
+    }
+    return impl_->index(p, impl_->buf);
+}
+
+void Corpus::add_files(const std::vector<fs::path>& paths) {
+    impl_->files.reserve(impl_->files.size() + paths.size());
+    for (const auto& p : paths) add_file(p);
+}
+
+// Files kept in flight by the io_uring reader.
+static constexpr unsigned kUringDepth = 128;
+
+// Queue with a fixed capacity: push() blocks
+// while full, pop() blocks while empty and fails once the queue is closed
+// and drained.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity_(capacity) {}
+
+    void push(T v) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [&] { return items_.size() < capacity_; });
+        items_.push_back(std::move(v));
+        not_empty_.notify_one();
+    }
+
+    bool pop(T& out) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [&] { return !items_.empty() || closed_; });
+        if (items_.empty()) return false;
+        out = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    // pop() without blocking; false when nothing is queued right now.
+    bool try_pop(T& out) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (items_.empty()) return false;
+        out = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        not_empty_.notify_all();
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable not_empty_, not_full_;
+    std::deque<T> items_;
+    size_t capacity_;
+    bool closed_ = false;
+};
+
+// Walk the globs, read and intern files on `jobs` loader threads while the
+// walk is still running, and insert them here as they arrive (which fills
+// the live seed table too). With io_uring, one reader thread keeps many
+// opens and reads in flight and hands the contents to the loaders; without
+// it the loaders read with blocking calls. Slots are sorted by path at the
+// end, so the result matches add_files(expand_globs(patterns)).
+void Corpus::add_globs(const std::vector<std::string>& patterns, unsigned jobs, Reader reader) {
+    Impl& im = *impl_;
+    if (jobs == 0) jobs = std::max(1u, std::thread::hardware_concurrency());
+    std::unique_ptr<UringReader> ring;
+    if (reader != Reader::Threads) {
+        ring = UringReader::open(kUringDepth);
+        if (!ring && reader == Reader::Uring) throw std::runtime_error("io_uring is not available");
+    }
+    DLOG(LogSub::Load, 1, "loading with " << jobs << (jobs == 1 ? " job" : " jobs")
+         << (ring ? ", io_uring reads" : ", blocking reads"));
+    PipelineTimer t(Phase::Load);
+    auto load = [&](const fs::path& p, std::string_view text) { im.insert(im.prepare(p, text, false)); };
+    // The ring stops reading a file whose sniff prefix is binary.
+    auto binary = [&](std::string_view prefix) {
+        size_t nontext;
+        bool saw_nul;
+        return sniff_binary(prefix, im.opts.binary_sniff_bytes, im.opts.binary_ratio, nontext, saw_nul);
+    };
+    // walk_globs(), reporting its own time as glob time: the time fn takes
+    // per file (loading it, or waiting for queue space) is left out.
+    auto walk = [&](auto&& fn) {
+        using Clock = std::chrono::steady_clock;
+        if (!g_stats.enabled) return walk_globs(patterns, fn);
+        const auto start = Clock::now();
+        Clock::duration in_fn{};
+        const size_t n = walk_globs(patterns, [&](const fs::path& p) {
+            const auto t0 = Clock::now();
+            fn(p);
+            in_fn += Clock::now() - t0;
+        });
+        add_worker_time(Phase::Glob, Clock::now() - start - in_fn);
+        return n;
+    };
+    if (jobs == 1) {
+        // No second core to overlap with: load files as they are found, in
+        // io_uring batches when available.
+        size_t n;
+        if (ring) {
+            std::vector<fs::path> batch;
+            auto flush = [&] {
+                size_t next = 0;
+                ring->read_all([&](fs::path& p, bool) {
+                    if (next == batch.size()) return false;
+                    p = std::move(batch[next++]);
+                    return true;
+                }, load, im.opts.binary_sniff_bytes, binary);
+                batch.clear();
+            };
+            n = walk([&](const fs::path& p) {
+                batch.push_back(p);
+                if (batch.size() == 4 * kUringDepth) flush();
+            });
+            flush();
+        } else {
+            n = walk([&](const fs::path& p) {
+                read_file_bytes(p, im.buf, &im.opts);
+                load(p, im.buf);
+            });
+        }
+        DLOG(LogSub::Glob, 1, "files matched: " << n);
+        im.sort_slots();
+        return;
+    }
+
+    struct Loaded {
+        fs::path path;
+        std::string text;
+    };
+    BoundedQueue<fs::path> paths(64 * jobs);
+    BoundedQueue<Loaded> loaded(4 * jobs);
+    BoundedQueue<Impl::Prepared> ready(4 * jobs);
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto fail = [&] {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!error) error = std::current_exception();
+    };
+
+    std::thread walker([&] {
+        try {
+            size_t n = walk([&](const fs::path& p) { paths.push(p); });
+            DLOG(LogSub::Glob, 1, "files matched: " << n);
+        } catch (...) {
+            fail();
+        }
+        paths.close();
+    });
+    std::thread uring_thread;
+    if (ring) {
+        uring_thread = std::thread([&] {
+            try {
+                ring->read_all([&](fs::path& p, bool wait) { return wait ? paths.pop(p) : paths.try_pop(p); },
+                               [&](fs::path& p, std::string& text) {
+                                   loaded.push({ std::move(p), std::move(text) });
+                               }, im.opts.binary_sniff_bytes, binary);
+            } catch (...) {
+                fail();
+                fs::path p;
+                while (paths.pop(p)) {} // unblock the walker
+            }
+            loaded.close();
+        });
+    }
+    // Without a ring, loaders read the files themselves.
+    auto next_file = [&](Loaded& item) {
+        if (ring) return loaded.pop(item);
+        if (!paths.pop(item.path)) return false;
+        read_file_bytes(item.path, item.text, &im.opts);
+        return true;
+    };
+    std::atomic<unsigned> running{ jobs };
+    std::vector<std::thread> loaders;
+    for (unsigned i = 0; i < jobs; ++i) {
+        loaders.emplace_back([&] {
+            Loaded item;
+            while (true) {
+                try {
+                    if (!next_file(item)) break;
+                    ready.push(im.prepare(item.path, item.text, false));
+                } catch (...) {
+                    fail();
+                }
+            }
+            if (--running == 0) ready.close();
+        });
+    }
+    Impl::Prepared doc;
+    while (ready.pop(doc)) im.insert(std::move(doc));
+    walker.join();
+    if (uring_thread.joinable()) uring_thread.join();
+    for (auto& th : loaders) th.join();
+    im.sort_slots();
+    if (error) std::rethrow_exception(error);
+}
+
+bool Corpus::add_buffer(const std::string& name, std::string_view text) {
+    return impl_->index(fs::path(name), text);
+}
+
+void Corpus::add_buffers(const std::vector<Document>& docs) {
+    impl_->files.reserve(impl_->files.size() + docs.size());
+    for (const auto& d : docs) add_buffer(d.name, d.text);
+}
+
+bool Corpus::remove(const std::string& name) {
+    return impl_->erase(doc_key(name));
+}
+
+bool Corpus::contains(const std::string& name) const {
+    return impl_->by_name.count(doc_key(name)) != 0;
+}
+
+void Corpus::keep_seed_index(size_t window) {
+    Impl& im = *impl_;
+    if (im.seed_window == window) return;
+    PhaseTimer t(Phase::Seed);
+    im.seeds = SeedTable();
+    im.seed_window = window;
+    size_t windows = 0;
+    for (const auto& fd : im.files) windows += window_count(fd.ids, window);
+    im.seeds.reserve(windows);
+    for (size_t slot = 0; slot < im.files.size(); ++slot) im.link_seeds(slot);
+    DLOG(LogSub::Match, 1, "live seed table (w=" << window << "): " << im.seeds.size() << " hashes");
+}
+
+std::vector<DuplicateBlock> Corpus::find_duplicates_of(const std::string& name, const MatchOptions& opts) const {
+    const Impl& im = *impl_;
+    auto it = im.by_name.find(doc_key(name));
+    if (it == im.by_name.end()) return {};
+    const int slot = static_cast<int>(it->second);
+    const size_t window = im.opts.granularity == Granularity::Tokens ? opts.min_tokens : opts.min_lines;
+    if (window == 0 || window != im.seed_window || opts.max_gap != 0) {
+        // No matching live table: full scan, keeping the blocks that touch
+        // the document.
+        const std::string path = to_generic_string(im.files[slot].path);
+        std::vector<DuplicateBlock> blocks = find_duplicates(opts);
+        blocks.erase(std::remove_if(blocks.begin(), blocks.end(), [&](const DuplicateBlock& b) {
+            return std::none_of(b.hits.begin(), b.hits.end(), [&](const Hit& h) { return h.path == path; });
+        }), blocks.end());
+        g_stats.blocks = blocks.size();
+        return blocks;
+    }
+    std::vector<DuplicateBlock> blocks = query_blocks(im.files, window, slot, slot + 1, 0,
+        [&](uint64_t hash, std::vector<Occurrence>& bucket) {
+            auto s = im.seeds.find(hash);
+            if (s != im.seeds.end()) bucket = s->second;
+        });
+    sort_blocks(blocks);
+    return blocks;
+}
+
+std::vector<DuplicateBlock> Corpus::find_duplicates(const MatchOptions& opts) const {
+    const Impl& im = *impl_;
+    DLOG(LogSub::Load, 1, "total files loaded: " << im.by_name.size());
+    if (im.skipped_binary > 0) {
+        DLOG(LogSub::Load, 1, "binary files skipped: " << im.skipped_binary);
+    }
+    DLOG(LogSub::Load, 1, "distinct normalized "
+         << (im.opts.granularity == Granularity::Tokens ? "tokens: " : "lines: ") << im.interner.size());
+    log_flush();
+
+    std::vector<DuplicateBlock> blocks = find_repeated_blocks(im.files, im.opts, opts, &im.seeds, im.seed_window);
+
+    sort_blocks(blocks);
+    return blocks;
+}
+
+void Corpus::visit_duplicates(const MatchOptions& opts, ResultVisitor& visitor) const {
+    visit_blocks(find_duplicates(opts), visitor);
+}
+
+std::vector<IdenticalFileSet> Corpus::identical_files() const {
+    const Impl& im = *impl_;
+    std::vector<IdenticalFileSet> sets;
+    std::unique_ptr<IdenticalFiles> same = find_identical_files(im.files, false);
+    if (!same) return sets;
+    for (size_t idx = 0; idx < im.files.size(); ++idx) {
+        if (same->copies[idx].empty()) continue;
+        IdenticalFileSet set;
+        set.lines = im.files[idx].lines.size();
+        set.paths.push_back(to_generic_string(im.files[idx].path));
+        for (int copy : same->copies[idx]) set.paths.push_back(to_generic_string(im.files[copy].path));
+        std::sort(set.paths.begin(), set.paths.end());
+        sets.push_back(std::move(set));
+    }
+    std::sort(sets.begin(), sets.end(), [](const IdenticalFileSet& a, const IdenticalFileSet& b) {
+        return a.paths.front() < b.paths.front();
+    });
+    return sets;
+}
+
+void visit_blocks(const std::vector<DuplicateBlock>& blocks, ResultVisitor& visitor) {
+    PhaseTimer t(Phase::Emit);
+    visitor.begin(blocks.size());
+    for (const auto& b : blocks) visitor.block(b);
+    visitor.end();
+}
+
+// ------------------------------- Index -------------------------------
+// On-disk layout (native byte order; version 2), flat arrays so loading is a
+// handful of large reads:
+//
+//   "DRYFIDX\0", u32 version, load options, u64 window
+//   units: u64 count, u64 blob size, blob, u64 offsets[count + 1],
+//          UnitSlot[count] sorted by unit_hash()
+//   files: u64 count, (u64 length, path bytes)[count], u64 offsets[count + 1],
+//          u32 ids[total], u32 line_of[total]
+//   seeds: u64 count, SeedEntry[count] sorted by (hash, file, start)
+
+static constexpr char kIndexMagic[8] = { 'D', 'R', 'Y', 'F', 'I', 'D', 'X', '\0' };
+static constexpr uint32_t kIndexVersion = 2;
+
+// Text hash -> unit ID, so query documents can be interned without
+// rebuilding a string map of every indexed unit.
+struct UnitSlot {
+    uint64_t hash;
+    uint32_t id;
+    uint32_t pad = 0;
+};
+
+struct IndexData {
+    LoadOptions opts;
+    size_t window = 0;
+    std::string unit_blob;
+    std::vector<uint64_t> unit_offsets; // unit i is unit_blob[offsets[i], offsets[i + 1])
+    std::vector<UnitSlot> unit_slots;
+    std::vector<FileData> files;        // paths, ids and line_of; no text
+    std::vector<SeedEntry> seeds;
+
+    std::string_view unit(uint32_t id) const {
+        return std::string_view(unit_blob).substr(unit_offsets[id], unit_offsets[id + 1] - unit_offsets[id]);
+    }
+};
+
+struct Index::Impl : IndexData {};
+
+// Interner for query documents: resolves text to the index's unit IDs and
+// gives unknown text fresh IDs above them, which match nothing indexed.
+class IndexInterner {
+public:
+    explicit IndexInterner(const IndexData& d) : d_(d) {}
+
+    uint32_t intern(std::string_view s) {
+        const uint64_t h = unit_hash(s);
+        auto it = std::lower_bound(d_.unit_slots.begin(), d_.unit_slots.end(), h,
+                                   [](const UnitSlot& u, uint64_t v) { return u.hash < v; });
+        for (; it != d_.unit_slots.end() && it->hash == h; ++it) {
+            if (d_.unit(it->id) == s) return it->id;
+        }
+        return static_cast<uint32_t>(d_.unit_slots.size()) + extra_.intern(s);
+    }
+
+private:
+    const IndexData& d_;
+    StringInterner extra_;
+};
+
+Index::Index() : impl_(std::make_unique<Impl>()) {}
+Index::~Index() = default;
+Index::Index(Index&&) noexcept = default;
+Index& Index::operator=(Index&&) noexcept = default;
+
+const LoadOptions& Index::options() const {
+    return impl_->opts;
+}
+
+size_t Index::window() const {
+    return impl_->window;
+}
+
+size_t Index::file_count() const {
+    return impl_->files.size();
+}
+
+Index Corpus::build_index(size_t window) const {
+    const Impl& im = *impl_;
+    Index index;
+    IndexData& d = *index.impl_;
+    d.opts = im.opts;
+    d.window = window;
+
+    PhaseTimer t(Phase::Seed);
+    // Renumber the units in order of first use so the file does not depend
+    // on the order loader threads interned them in (and drops units of
+    // replaced documents).
+    const std::vector<std::string_view> interned = im.interner.by_id();
+    std::vector<uint32_t> renumber(interned.size(), UINT32_MAX);
+    std::vector<std::string_view> units;
+    d.files.reserve(im.by_name.size());
+    for (const auto& f : im.files) {
+        if (f.path.empty()) continue; // removed document
+        FileData fd;
+        fd.path = f.path;
+        fd.ids.reserve(f.ids.size());
+        for (uint32_t id : f.ids) {
+            if (renumber[id] == UINT32_MAX) {
+                renumber[id] = static_cast<uint32_t>(units.size());
+                units.push_back(interned[id]);
+            }
+            fd.ids.push_back(renumber[id]);
+        }
+        fd.line_of = f.line_of;
+        d.files.push_back(std::move(fd));
+    }
+    d.unit_offsets.reserve(units.size() + 1);
+    d.unit_slots.reserve(units.size());
+    d.unit_offsets.push_back(0);
+    for (uint32_t id = 0; id < units.size(); ++id) {
+        d.unit_blob += units[id];
+        d.unit_offsets.push_back(d.unit_blob.size());
+        d.unit_slots.push_back({ unit_hash(units[id]), id });
+    }
+    std::sort(d.unit_slots.begin(), d.unit_slots.end(), [](const UnitSlot& a, const UnitSlot& b) {
+        return a.hash != b.hash ? a.hash < b.hash : a.id < b.id;
+    });
+
+    for (uint32_t fi = 0; fi < d.files.size(); ++fi) {
+        for_each_window_hash(d.files[fi].ids, window, [&](size_t start, uint64_t h) {
+            d.seeds.push_back({ h, fi, static_cast<uint32_t>(start) });
+        });
+    }
+    std::sort(d.seeds.begin(), d.seeds.end(), seed_entry_less);
+    DLOG(LogSub::Match, 1, "index built: files=" << d.files.size() << " units=" << units.size()
+         << " seeds=" << d.seeds.size() << " window=" << window);
+    return index;
+}
+
+template <typename T>
+static void write_pod(std::ostream& out, const T& v) {
+    out.write(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+template <typename T>
+static void write_array(std::ostream& out, const std::vector<T>& v) {
+    out.write(reinterpret_cast<const char*>(v.data()), static_cast<std::streamsize>(v.size() * sizeof(T)));
+}
+
+template <typename T>
+static T read_pod(std::istream& in) {
+    T v{};
+    in.read(reinterpret_cast<char*>(&v), sizeof(T));
+    return v;
+}
+
+// `limit` is the file size: counts read from a corrupt file must not turn
+// into huge allocations.
+template <typename T>
+static void read_array(std::istream& in, std::vector<T>& v, uint64_t n, uint64_t limit) {
+    if (!in || n > limit / sizeof(T)) throw std::runtime_error("truncated index");
+    v.resize(static_cast<size_t>(n));
+    in.read(reinterpret_cast<char*>(v.data()), static_cast<std::streamsize>(v.size() * sizeof(T)));
+}
+
+static void write_load_options(std::ostream& out, const LoadOptions& o) {
+    write_pod(out, static_cast<uint8_t>(o.granularity));
+    const uint8_t flags = (o.ignore_indent ? 1 : 0) | (o.ignore_trailing_ws ? 2 : 0) |
+                          (o.collapse_ws ? 4 : 0) | (o.ignore_blank_lines ? 8 : 0) |
+                          (o.normalize_identifiers ? 16 : 0);
+    write_pod(out, flags);
+    write_pod(out, static_cast<uint64_t>(o.binary_sniff_bytes));
+    write_pod(out, o.binary_ratio);
+}
+
+static LoadOptions read_load_options(std::istream& in) {
+    LoadOptions o;
+    o.granularity = static_cast<Granularity>(read_pod<uint8_t>(in));
+    const uint8_t flags = read_pod<uint8_t>(in);
+    o.ignore_indent = flags & 1;
+    o.ignore_trailing_ws = flags & 2;
+    o.collapse_ws = flags & 4;
+    o.ignore_blank_lines = flags & 8;
+    o.normalize_identifiers = flags & 16;
+    o.binary_sniff_bytes = static_cast<size_t>(read_pod<uint64_t>(in));
+    o.binary_ratio = read_pod<double>(in);
+    return o;
+}
+
+void Index::save(const fs::path& path) const {
+    const IndexData& d = *impl_;
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) throw std::runtime_error("cannot write index " + to_generic_string(path));
+
+    out.write(kIndexMagic, sizeof(kIndexMagic));
+    write_pod(out, kIndexVersion);
+    write_load_options(out, d.opts);
+    write_pod(out, static_cast<uint64_t>(d.window));
+
+    write_pod(out, static_cast<uint64_t>(d.unit_slots.size()));
+    write_pod(out, static_cast<uint64_t>(d.unit_blob.size()));
+    out.write(d.unit_blob.data(), static_cast<std::streamsize>(d.unit_blob.size()));
+    write_array(out, d.unit_offsets);
+    write_array(out, d.unit_slots);
+
+    write_pod(out, static_cast<uint64_t>(d.files.size()));
+    std::vector<uint64_t> offsets{ 0 };
+    for (const auto& f : d.files) {
+        const std::string p = to_generic_string(f.path);
+        write_pod(out, static_cast<uint64_t>(p.size()));
+        out.write(p.data(), static_cast<std::streamsize>(p.size()));
+        offsets.push_back(offsets.back() + f.ids.size());
+    }
+    write_array(out, offsets);
+    for (const auto& f : d.files) write_array(out, f.ids);
+    for (const auto& f : d.files) write_array(out, f.line_of);
+
+    write_pod(out, static_cast<uint64_t>(d.seeds.size()));
+    write_array(out, d.seeds);
+    out.flush();
+    if (!out) throw std::runtime_error("cannot write index " + to_generic_string(path));
+    DLOG(LogSub::Emit, 1, "index written: " << to_generic_string(path));
+}
+
+// Checks that the values read from an index stay inside the tables they
+// refer to, so a damaged file is rejected at load rather than indexing out
+// of bounds during a query. Line counts are not stored; line_of must be
+// nondecreasing, which is what keeps a hit's end line at or after its start.
+static void check_index(const IndexData& d) {
+    const auto bad = [] { throw std::runtime_error("truncated index"); };
+    const size_t n_units = d.unit_slots.size();
+    if (d.window == 0) bad();
+    for (size_t i = 0; i < n_units; ++i) {
+        if (d.unit_offsets[i + 1] < d.unit_offsets[i]) bad();
+        if (d.unit_slots[i].id >= n_units) bad();
+        if (i > 0 && d.unit_slots[i].hash < d.unit_slots[i - 1].hash) bad();
+    }
+    if (d.unit_offsets[n_units] > d.unit_blob.size()) bad();
+    for (const auto& f : d.files) {
+        for (size_t i = 0; i < f.ids.size(); ++i) {
+            if (f.ids[i] >= n_units) bad();
+            if (i > 0 && f.line_of[i] < f.line_of[i - 1]) bad();
+        }
+    }
+    for (size_t k = 0; k < d.seeds.size(); ++k) {
+        const SeedEntry& e = d.seeds[k];
+        if (e.file >= d.files.size()) bad();
+        const size_t units = d.files[e.file].ids.size();
+        if (e.start > units || units - e.start < d.window) bad();
+        if (k > 0 && e.hash < d.seeds[k - 1].hash) bad();
+    }
+}
+
+Index Index::load(const fs::path& path) {
+    PhaseTimer t(Phase::Load);
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("cannot read index " + to_generic_string(path));
+    const std::string where = " in " + to_generic_string(path);
+    std::error_code ec;
+    const uint64_t limit = fs::file_size(path, ec);
+
+    char magic[sizeof(kIndexMagic)] = {};
+    in.read(magic, sizeof(magic));
+    if (!in || !std::equal(magic, magic + sizeof(magic), kIndexMagic))
+        throw std::runtime_error("not a dryfinder index" + where);
+    if (read_pod<uint32_t>(in) != kIndexVersion)
+        throw std::runtime_error("unsupported index version" + where);
+
+    Index index;
+    IndexData& d = *index.impl_;
+    d.opts = read_load_options(in);
+    d.window = static_cast<size_t>(read_pod<uint64_t>(in));
+
+    try {
+        const uint64_t n_units = read_pod<uint64_t>(in);
+        std::vector<char> blob;
+        read_array(in, blob, read_pod<uint64_t>(in), limit);
+        d.unit_blob.assign(blob.begin(), blob.end());
+        read_array(in, d.unit_offsets, n_units + 1, limit);
+        read_array(in, d.unit_slots, n_units, limit);
+
+        const uint64_t n_files = read_pod<uint64_t>(in);
+        std::vector<uint64_t> offsets;
+        std::vector<char> p;
+        if (n_files > limit) throw std::runtime_error("truncated index");
+        d.files.resize(static_cast<size_t>(n_files));
+        for (auto& f : d.files) {
+            read_array(in, p, read_pod<uint64_t>(in), limit);
+            f.path = std::string(p.begin(), p.end());
+        }
+        read_array(in, offsets, n_files + 1, limit);
+        for (size_t i = 0; i < d.files.size(); ++i) {
+            if (offsets[i + 1] < offsets[i]) throw std::runtime_error("truncated index");
+            read_array(in, d.files[i].ids, offsets[i + 1] - offsets[i], limit);
+        }
+        for (size_t i = 0; i < d.files.size(); ++i) {
+            read_array(in, d.files[i].line_of, offsets[i + 1] - offsets[i], limit);
+        }
+        read_array(in, d.seeds, read_pod<uint64_t>(in), limit);
+        if (!in) throw std::runtime_error("truncated index");
+        check_index(d);
+    } catch (const std::runtime_error& e) {
+        throw std::runtime_error(e.what() + where);
+    }
+    DLOG(LogSub::Load, 1, "index loaded: files=" << d.files.size() << " units=" << d.unit_slots.size()
+         << " seeds=" << d.seeds.size() << " window=" << d.window);
+    return index;
+}
+
+std::vector<DuplicateBlock> Index::query(const std::vector<Document>& docs) {
+    IndexData& d = *impl_;
+    const size_t w = d.window;
+    const int n_index = static_cast<int>(d.files.size());
+
+    // Query documents are appended after the indexed files for the duration
+    // of the query, so the engine's helpers see one file list.
+    struct Restore {
+        std::vector<FileData>& files;
+        size_t n;
+        ~Restore() { files.resize(n); }
+    } restore{ d.files, d.files.size() };
+
+    // An indexed file that is being queried is superseded by its new text
+    // and reported under the spelling the index was built with ("a.c" and
+    // "./a.c" name the same file).
+    std::unordered_map<std::string, int> indexed;
+    indexed.reserve(static_cast<size_t>(n_index));
+    for (int i = 0; i < n_index; ++i) indexed.emplace(doc_key(d.files[i].path), i);
+    std::vector<char> replaced(static_cast<size_t>(n_index), 0);
+
+    IndexInterner interner(d);
+    for (const auto& doc : docs) {
+        fs::path p(doc.name);
+        const auto known = indexed.find(doc_key(p));
+        if (known != indexed.end()) p = d.files[known->second].path;
+        g_stats.bytes_read += doc.text.size();
+        {
+            PhaseTimer t(Phase::Sniff);
+            if (is_probably_binary(doc.text, p, d.opts.binary_sniff_bytes, d.opts.binary_ratio)) continue;
+        }
+        PhaseTimer t(Phase::Load);
+        FileData fd;
+        fd.path = p;
+        fd.lines = split_lines_normalized(doc.text);
+        if (d.opts.granularity == Granularity::Tokens) assign_token_ids(fd, d.opts, interner);
+        else assign_line_ids(fd, d.opts, interner);
+        ++g_stats.files;
+        g_stats.lines += fd.lines.size();
+        g_stats.units += fd.ids.size();
+        if (known != indexed.end()) replaced[known->second] = 1;
+        d.files.push_back(std::move(fd));
+    }
+
+    SeedTable own;
+    size_t own_windows = 0;
+    for (int k = n_index; k < static_cast<int>(d.files.size()); ++k) own_windows += window_count(d.files[k].ids, w);
+    own.reserve(own_windows);
+    for (int k = n_index; k < static_cast<int>(d.files.size()); ++k) {
+        for_each_window_hash(d.files[k].ids, w, [&](size_t start, uint64_t h) {
+            own[h].push_back({ k, start });
+        });
+    }
+    std::vector<DuplicateBlock> blocks = query_blocks(d.files, w, n_index, static_cast<int>(d.files.size()), n_index,
+        [&](uint64_t hash, std::vector<Occurrence>& bucket) {
+            bucket = own[hash];
+            auto range = std::equal_range(d.seeds.begin(), d.seeds.end(), SeedEntry{ hash, 0, 0 },
+                                          [](const SeedEntry& a, const SeedEntry& b) { return a.hash < b.hash; });
+            for (auto it = range.first; it != range.second; ++it) {
+                if (!replaced[it->file]) bucket.push_back({ static_cast<int>(it->file), it->start });
+            }
+        });
+    sort_blocks(blocks);
+    return blocks;
+}
+
+std::vector<DuplicateBlock> Index::query_files(const std::vector<fs::path>& paths) {
+    std::vector<std::string> texts(paths.size());
+    std::vector<Document> docs;
+    docs.reserve(paths.size());
+    for (size_t i = 0; i < paths.size(); ++i) {
+        {
+            PhaseTimer t(Phase::Load);
+            read_file_bytes(paths[i], texts[i], &impl_->opts);
+        }
+        docs.push_back({ to_generic_string(paths[i]), texts[i] });
+    }
+    return query(docs);
+}
+
+// ------------------------------- Shards ------------------------------
+// Partial file of one shard (native byte order; version 2):
+//
+//   "DRYFSHD\0", u32 version, u32 shard, u32 count, load options,
+//   u64 window, u64 corpus fingerprint
+//   paths: u64 count, (u64 length, bytes)[count]
+//   blocks: u64 count, then per block: u64 key length, key bytes,
+//           u64 period, u64 repeats,
+//           u64 line count, (u64 length, bytes)[lines], u64 text hit,
+//           u64 hit count, (u32 path, u32 pad, u64 start, u64 end)[hits]
+//
+// Periodic blocks are written by shard 0 only, keyed by their position.
+
+static constexpr char kShardMagic[8] = { 'D', 'R', 'Y', 'F', 'S', 'H', 'D', '\0' };
+static constexpr uint32_t kShardVersion = 2;
+
+struct ShardHit {
+    uint32_t path;
+    uint32_t pad = 0;
+    uint64_t start_line;
+    uint64_t end_line;
+};
+
+static void write_string(std::ostream& out, std::string_view s) {
+    write_pod(out, static_cast<uint64_t>(s.size()));
+    out.write(s.data(), static_cast<std::streamsize>(s.size()));
+}
+
+static std::string read_string(std::istream& in, uint64_t limit) {
+    std::vector<char> v;
+    read_array(in, v, read_pod<uint64_t>(in), limit);
+    return std::string(v.begin(), v.end());
+}
+
+// Identifies the corpus a shard matched: partials can only be merged when
+// every shard loaded the same files.
+static uint64_t corpus_fingerprint(const std::vector<FileData>& files) {
+    uint64_t h = 0;
+    for (const auto& f : files) {
+        if (f.path.empty()) continue; // removed document
+        h = mix64(h + fnv1a64(to_generic_string(f.path)));
+        h = mix64(h + f.ids.size());
+    }
+    return h;
+}
+
+void Corpus::write_shard(const MatchOptions& opts, unsigned shard, unsigned count, const fs::path& path) const {
+    const Impl& im = *impl_;
+    if (count == 0 || shard >= count) throw std::runtime_error("shard index out of range");
+    if (opts.engine != Engine::Seed || opts.max_gap != 0)
+        throw std::runtime_error("sharded scans need the seed engine and no --max-gap");
+    const size_t window = im.opts.granularity == Granularity::Tokens ? opts.min_tokens : opts.min_lines;
+
+    const ShardFilter filter(shard, count, im.interner.by_id());
+    std::unique_ptr<IdenticalFiles> same = find_identical_files(im.files, true);
+    BlockAggregator agg(im.files, 0, same.get());
+    const SeedTable* live = window == im.seed_window ? &im.seeds : nullptr;
+    const Runs runs(im.files, window);
+    const size_t groups_built = seed_engine_groups(im.files, window, opts, live, &filter, same.get(), runs,
+                                                   [&](const MaximalGroup& g) { agg.add(g); });
+    std::vector<PartialBlock> blocks;
+    {
+        PhaseTimer t(Phase::Aggregate);
+        agg.finish_partial(blocks, filter.units);
+        if (shard == 0) {
+            std::vector<DuplicateBlock> periodic;
+            add_periodic_blocks(im.files, runs, 0, static_cast<int>(im.files.size()), periodic);
+            for (auto& b : periodic) {
+                PartialBlock p;
+                p.key = std::to_string(blocks.size()); // token-mode runs can share a start line
+                p.block = std::move(b);
+                blocks.push_back(std::move(p));
+            }
+        }
+    }
+    DLOG(LogSub::Match, 1, "shard " << shard << "/" << count << ": maximal groups built: " << groups_built
+         << " | partial blocks: " << blocks.size());
+
+    PhaseTimer t(Phase::Emit);
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) throw std::runtime_error("cannot write shard " + to_generic_string(path));
+    out.write(kShardMagic, sizeof(kShardMagic));
+    write_pod(out, kShardVersion);
+    write_pod(out, static_cast<uint32_t>(shard));
+    write_pod(out, static_cast<uint32_t>(count));
+    write_load_options(out, im.opts);
+    write_pod(out, static_cast<uint64_t>(window));
+    write_pod(out, corpus_fingerprint(im.files));
+
+    std::vector<std::string> paths;
+    std::unordered_map<std::string, uint32_t> path_ids;
+    for (const auto& p : blocks) {
+        for (const auto& h : p.block.hits) {
+            if (path_ids.emplace(h.path, static_cast<uint32_t>(paths.size())).second) paths.push_back(h.path);
+        }
+    }
+    write_pod(out, static_cast<uint64_t>(paths.size()));
+    for (const auto& p : paths) write_string(out, p);
+
+    write_pod(out, static_cast<uint64_t>(blocks.size()));
+    std::vector<ShardHit> hits;
+    for (const auto& p : blocks) {
+        write_string(out, p.key);
+        write_pod(out, static_cast<uint64_t>(p.block.period));
+        write_pod(out, static_cast<uint64_t>(p.block.repeats));
+        write_pod(out, static_cast<uint64_t>(p.block.lines.size()));
+        for (const auto& line : p.block.lines) write_string(out, line);
+        write_pod(out, static_cast<uint64_t>(p.text_hit));
+        hits.clear();
+        for (const auto& h : p.block.hits) {
+            hits.push_back({ path_ids[h.path], 0, static_cast<uint64_t>(h.start_line),
+                             static_cast<uint64_t>(h.end_line) });
+        }
+        write_pod(out, static_cast<uint64_t>(hits.size()));
+        write_array(out, hits);
+    }
+    out.flush();
+    if (!out) throw std::runtime_error("cannot write shard " + to_generic_string(path));
+    DLOG(LogSub::Emit, 1, "shard written: " << to_generic_string(path));
+}
+
+// Union the partial blocks by content: hits are deduplicated and the text
+// comes from the first hit by (path, start line), as in a single scan.
+// Periodic blocks are kept apart from the others.
+std::vector<DuplicateBlock> merge_shards(const std::vector<fs::path>& partials) {
+    struct Merged {
+        DuplicateBlock block;
+        FlatHashMap<std::string, std::monostate, TextHash> hit_keys;
+        Hit text_from; // hit whose lines are shown
+        bool has_text = false;
+    };
+    FlatHashMap<std::string, Merged, TextHash> by_content;
+    std::vector<bool> seen;
+    uint32_t count = 0;
+    LoadOptions first_opts;
+    uint64_t window = 0, fingerprint = 0;
+
+    for (const auto& path : partials) {
+        PhaseTimer t(Phase::Load);
+        std::ifstream in(path, std::ios::binary);
+        if (!in) throw std::runtime_error("cannot read shard " + to_generic_string(path));
+        const std::string where = " in " + to_generic_string(path);
+        std::error_code ec;
+        const uint64_t limit = fs::file_size(path, ec);
+
+        char magic[sizeof(kShardMagic)] = {};
+        in.read(magic, sizeof(magic));
+        if (!in || !std::equal(magic, magic + sizeof(magic), kShardMagic))
+            throw std::runtime_error("not a dryfinder shard" + where);
+        if (read_pod<uint32_t>(in) != kShardVersion)
+            throw std::runtime_error("unsupported shard version" + where);
+        const uint32_t shard = read_pod<uint32_t>(in);
+        const uint32_t n = read_pod<uint32_t>(in);
+        const LoadOptions opts = read_load_options(in);
+        const uint64_t w = read_pod<uint64_t>(in);
+        const uint64_t fp = read_pod<uint64_t>(in);
+        if (!in || n == 0 || shard >= n) throw std::runtime_error("truncated shard" + where);
+        if (seen.empty()) {
+            count = n;
+            seen.assign(n, false);
+            first_opts = opts;
+            window = w;
+            fingerprint = fp;
+        }
+        const bool same_opts = opts.granularity == first_opts.granularity &&
+            opts.ignore_indent == first_opts.ignore_indent &&
+            opts.ignore_trailing_ws == first_opts.ignore_trailing_ws &&
+            opts.collapse_ws == first_opts.collapse_ws &&
+            opts.ignore_blank_lines == first_opts.ignore_blank_lines &&
+            opts.normalize_identifiers == first_opts.normalize_identifiers &&
+            opts.binary_sniff_bytes == first_opts.binary_sniff_bytes &&
+            opts.binary_ratio == first_opts.binary_ratio;
+        if (n != count || !same_opts || w != window || fp != fingerprint)
+            throw std::runtime_error("shard is from a different scan" + where);
+        if (seen[shard]) throw std::runtime_error("duplicate shard " + std::to_string(shard) + where);
+        seen[shard] = true;
+
+        try {
+            const uint64_t n_paths = read_pod<uint64_t>(in);
+            if (n_paths > limit) throw std::runtime_error("truncated shard");
+            std::vector<std::string> paths(static_cast<size_t>(n_paths));
+            for (auto& p : paths) p = read_string(in, limit);
+
+            const uint64_t n_blocks = read_pod<uint64_t>(in);
+            if (n_blocks > limit) throw std::runtime_error("truncated shard");
+            std::vector<ShardHit> hits;
+            for (uint64_t b = 0; b < n_blocks; ++b) {
+                const std::string key = read_string(in, limit);
+                const uint64_t period = read_pod<uint64_t>(in);
+                const uint64_t repeats = read_pod<uint64_t>(in);
+                const uint64_t n_lines = read_pod<uint64_t>(in);
+                if (n_lines > limit) throw std::runtime_error("truncated shard");
+                std::vector<std::string> lines(static_cast<size_t>(n_lines));
+                for (auto& line : lines) line = read_string(in, limit);
+                const uint64_t text_hit = read_pod<uint64_t>(in);
+                read_array(in, hits, read_pod<uint64_t>(in), limit);
+                if (!in || text_hit >= hits.size()) throw std::runtime_error("truncated shard");
+
+                Merged& m = by_content[(period ? 'p' : 'b') + key];
+                m.block.period = static_cast<size_t>(period);
+                m.block.repeats = static_cast<size_t>(repeats);
+                for (size_t i = 0; i < hits.size(); ++i) {
+                    if (hits[i].path >= paths.size()) throw std::runtime_error("truncated shard");
+                    Hit h;
+                    h.path = paths[hits[i].path];
+                    h.start_line = static_cast<size_t>(hits[i].start_line);
+                    h.end_line = static_cast<size_t>(hits[i].end_line);
+                    if (i == text_hit) {
+                        const bool first = !m.has_text || h.path < m.text_from.path ||
+                            (h.path == m.text_from.path && h.start_line < m.text_from.start_line);
+                        if (first) {
+                            m.text_from = h;
+                            m.block.lines = std::move(lines);
+                            m.has_text = true;
+                        }
+                    }
+                    std::string hk = h.path + '\n' + std::to_string(h.start_line) + '\n' +
+                                     std::to_string(h.end_line);
+                    if (m.hit_keys.try_emplace(std::move(hk)).second) m.block.hits.push_back(std::move(h));
+                }
+            }
+        } catch (const std::runtime_error& e) {
+            throw std::runtime_error(e.what() + where);
+        }
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        if (!seen[i]) throw std::runtime_error("missing shard " + std::to_string(i) + " of " + std::to_string(count));
+    }
+
+    std::vector<DuplicateBlock> blocks;
+    {
+        PhaseTimer t(Phase::Aggregate);
+        for (auto& [key, m] : by_content) {
+            if (m.block.hits.size() >= 2 || m.block.period != 0) blocks.push_back(std::move(m.block));
+        }
+    }
+    DLOG(LogSub::Match, 1, "merged " << partials.size() << " shards: " << by_content.size()
+         << " partial blocks, " << blocks.size() << " blocks");
+    sort_blocks(blocks);
+    return blocks;
+}
+
+// --------------------------- YAML Emission ----------------------------
+
+static size_t bytes_of_lines(const std::vector<std::string>& lines) {
+    size_t n = 0;
+    if (lines.empty()) return 0;
+    for (const auto& s : lines) n += s.size() + 1; // + '\n'
+    return n;
+}
+
+void YamlWriter::begin(size_t block_count) {
+    (void)block_count;
+    out_ << "blocks:\n";
+    written_ = 0;
+}
+
+void YamlWriter::block(const DuplicateBlock& b) {
+    out_ << "  - lines: " << b.lines.size() << "\n";
+    out_ << "    bytes: " << bytes_of_lines(b.lines) << "\n";
+    out_ << "    occurrences: " << b.hits.size() << "\n";
+    const size_t listed = max_hits_ != 0 ? std::min(max_hits_, b.hits.size()) : b.hits.size();
+    if (listed < b.hits.size()) out_ << "    hits_omitted: " << b.hits.size() - listed << "\n";
+    if (b.period != 0) {
+        out_ << "    period: " << b.period << "\n";
+        out_ << "    repeats: " << b.repeats << "\n";
+    }
+    out_ << "    hits:\n";
+    for (size_t i = 0; i < listed; ++i) {
+        const Hit& h = b.hits[i];
+        out_ << "      - file: " << yaml_escape(h.path) << "\n";
+        out_ << "        start_line: " << h.start_line << "\n";
+        out_ << "        end_line: " << h.end_line << "\n";
+    }
+    out_ << "    content: |\n";
+    for (const auto& line : b.lines) {
+        out_ << "      " << line << "\n";
+    }
+    ++written_;
+}
+
+void YamlWriter::identical_files(const std::vector<IdenticalFileSet>& sets) {
+    out_ << "identical_files:" << (sets.empty() ? " []\n" : "\n");
+    for (const auto& set : sets) {
+        out_ << "  - lines: " << set.lines << "\n";
+        out_ << "    files:\n";
+        for (const auto& p : set.paths) out_ << "      - " << yaml_escape(p) << "\n";
+    }
+    out_.flush();
+}
+
+void YamlWriter::end() {
+    out_.flush();
+    DLOG(LogSub::Emit, 1, "yaml emission complete for " << written_ << " block(s)");
+}
+
+} // namespace dryfinder
@@ -0,0 +1,280 @@
+#include "uring.hpp"
+#include "diag.hpp"
+
+#if defined(__linux__)
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace dryfinder {
+
+#if defined(__linux__)
+
+// The raw interface (no liburing): one submission and one completion ring
+// shared with the kernel, indices published with acquire/release.
+struct UringReader::Ring {
+    int fd = -1;
+    void* sq_ptr = MAP_FAILED;
+    void* cq_ptr = MAP_FAILED;
+    size_t sq_len = 0, cq_len = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqes_len = 0;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    io_uring_cqe* cqes;
+    unsigned sq_entries = 0;
+    unsigned to_submit = 0;
+    unsigned depth = 0;
+
+    ~Ring() {
+        if (sqes != MAP_FAILED) ::munmap(sqes, sqes_len);
+        if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) ::munmap(cq_ptr, cq_len);
+        if (sq_ptr != MAP_FAILED) ::munmap(sq_ptr, sq_len);
+        if (fd >= 0) ::close(fd);
+    }
+
+    // Callers never queue more than sq_entries operations between enters.
+    io_uring_sqe* get_sqe() {
+        const unsigned tail = *sq_tail;
+        const unsigned index = tail & *sq_mask;
+        io_uring_sqe* sqe = &sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sq_array[index] = index;
+        std::atomic_ref<unsigned>(*sq_tail).store(tail + 1, std::memory_order_release);
+        ++to_submit;
+        return sqe;
+    }
+
+    // Submit everything queued and wait for at least one completion.
+    void submit_and_wait() {
+        while (true) {
+            long n = ::syscall(__NR_io_uring_enter, fd, to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (n >= 0) {
+                to_submit -= static_cast<unsigned>(n);
+                if (to_submit == 0) return;
+                continue;
+            }
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY) continue;
+            throw std::runtime_error(std::string("io_uring_enter: ") + std::strerror(errno));
+        }
+    }
+
+    template <typename Fn>
+    void reap(Fn&& fn) {
+        unsigned head = *cq_head;
+        const unsigned tail = std::atomic_ref<unsigned>(*cq_tail).load(std::memory_order_acquire);
+        for (; head != tail; ++head) {
+            const io_uring_cqe& cqe = cqes[head & *cq_mask];
+            fn(cqe.user_data, cqe.res);
+        }
+        std::atomic_ref<unsigned>(*cq_head).store(head, std::memory_order_release);
+    }
+};
+
+static bool supports_ops(int fd) {
+    const unsigned nops = 256;
+    std::vector<unsigned char> mem(sizeof(io_uring_probe) + nops * sizeof(io_uring_probe_op));
+    auto* probe = reinterpret_cast<io_uring_probe*>(mem.data());
+    if (::syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, nops) < 0) return false;
+    for (unsigned op : { IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ }) {
+        if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) return false;
+    }
+    return true;
+}
+
+std::unique_ptr<UringReader> UringReader::open(unsigned depth) {
+    auto ring = std::make_unique<Ring>();
+    // A file has at most two operations in flight (open and statx).
+    io_uring_params p {};
+    ring->fd = static_cast<int>(::syscall(__NR_io_uring_setup, 2 * depth, &p));
+    if (ring->fd < 0) {
+        DLOG(LogSub::Load, 1, "io_uring unavailable: " << std::strerror(errno));
+        return nullptr;
+    }
+    if (!supports_ops(ring->fd)) {
+        DLOG(LogSub::Load, 1, "io_uring lacks openat/statx/read");
+        return nullptr;
+    }
+    ring->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    const bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (single) ring->sq_len = ring->cq_len = std::max(ring->sq_len, ring->cq_len);
+    ring->sq_ptr = ::mmap(nullptr, ring->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED) return nullptr;
+    ring->cq_ptr = single ? ring->sq_ptr
+                          : ::mmap(nullptr, ring->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                   ring->fd, IORING_OFF_CQ_RING);
+    if (ring->cq_ptr == MAP_FAILED) return nullptr;
+    ring->sqes_len = p.sq_entries * sizeof(io_uring_sqe);
+    ring->sqes = static_cast<io_uring_sqe*>(::mmap(nullptr, ring->sqes_len, PROT_READ | PROT_WRITE,
+                                                   MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES));
+    if (ring->sqes == MAP_FAILED) return nullptr;
+
+    auto* sq = static_cast<char*>(ring->sq_ptr);
+    auto* cq = static_cast<char*>(ring->cq_ptr);
+    ring->sq_head = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+    ring->sq_tail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+    ring->sq_mask = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+    ring->sq_array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+    ring->cq_head = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+    ring->cq_tail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+    ring->cq_mask = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+    ring->cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+    ring->sq_entries = p.sq_entries;
+    ring->depth = std::min(depth, p.sq_entries / 2);
+    DLOG(LogSub::Load, 1, "io_uring: " << ring->depth << " files in flight");
+    return std::unique_ptr<UringReader>(new UringReader(std::move(ring)));
+}
+
+UringReader::UringReader(std::unique_ptr<Ring> ring) : ring_(std::move(ring)) {}
+UringReader::~UringReader() = default;
+
+// Per file: openat and statx go out together; once both are back, reads of
+// the statx size plus one byte follow until EOF. A read that fills the
+// buffer means the file grew (or reported size 0, e.g. procfs): grow and
+// keep reading, as read_file_bytes() does. With a prefix, the first read
+// asks for just the prefix, and the rest is read only if stop() declines.
+void UringReader::read_all(const NextFn& next, const DoneFn& done, size_t prefix, const StopFn& stop) {
+    enum Op : uint64_t { Open = 0, Statx = 1, Read = 2 };
+    struct Slot {
+        fs::path path;
+        int fd = -1;
+        int pending = 0;
+        struct statx stx {};
+        std::string buf;
+        size_t len = 0;
+        bool sniffed = false; // stop() has seen the prefix
+    };
+    Ring& r = *ring_;
+    std::vector<Slot> slots(r.depth);
+    std::vector<size_t> free_slots;
+    for (size_t i = slots.size(); i-- > 0;) free_slots.push_back(i);
+    size_t busy = 0;
+
+    auto submit_read = [&](size_t i) {
+        Slot& s = slots[i];
+        io_uring_sqe* sqe = r.get_sqe();
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = s.fd;
+        sqe->addr = reinterpret_cast<uint64_t>(s.buf.data() + s.len);
+        sqe->len = static_cast<uint32_t>(std::min<size_t>(s.buf.size() - s.len, 1u << 30));
+        sqe->off = s.len;
+        sqe->user_data = (i << 2) | Read;
+        s.pending = 1;
+    };
+    auto finish = [&](size_t i) {
+        Slot& s = slots[i];
+        if (s.fd >= 0) ::close(s.fd);
+        s.fd = -1;
+        s.buf.resize(s.len);
+        done(s.path, s.buf);
+        s.buf = std::string();
+        free_slots.push_back(i);
+        --busy;
+    };
+    auto start = [&](size_t i) {
+        Slot& s = slots[i];
+        s.len = 0;
+        s.stx = {};
+        s.sniffed = prefix == 0 || !stop;
+        io_uring_sqe* sqe = r.get_sqe();
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = reinterpret_cast<uint64_t>(s.path.c_str());
+        sqe->open_flags = O_RDONLY | O_CLOEXEC;
+        sqe->user_data = (i << 2) | Open;
+        sqe = r.get_sqe();
+        sqe->opcode = IORING_OP_STATX;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = reinterpret_cast<uint64_t>(s.path.c_str());
+        sqe->len = STATX_SIZE;
+        sqe->off = reinterpret_cast<uint64_t>(&s.stx);
+        sqe->user_data = (i << 2) | Statx;
+        s.pending = 2;
+        ++busy;
+    };
+    auto complete = [&](uint64_t user_data, int res) {
+        const size_t i = static_cast<size_t>(user_data >> 2);
+        Slot& s = slots[i];
+        switch (static_cast<Op>(user_data & 3)) {
+            case Open:
+                s.fd = res;
+                break;
+            case Statx:
+                if (res < 0) s.stx.stx_size = 0;
+                break;
+            case Read:
+                if (res == -EINTR || res == -EAGAIN) return submit_read(i);
+                if (res <= 0) return finish(i); // EOF, or an error: keep what was read
+                s.len += static_cast<size_t>(res);
+                if (!s.sniffed && s.len >= prefix) {
+                    s.sniffed = true;
+                    if (stop(std::string_view(s.buf.data(), s.len))) return finish(i);
+                    const size_t full = s.stx.stx_size != 0 ? static_cast<size_t>(s.stx.stx_size) + 1 : 0;
+                    s.buf.resize(std::max(full, 2 * s.buf.size()));
+                    return submit_read(i);
+                }
+                if (s.len == s.buf.size()) {
+                    s.buf.resize(s.buf.size() * 2);
+                } else if (s.stx.stx_size != 0 && s.len >= s.stx.stx_size) {
+                    return finish(i);
+                }
+                return submit_read(i);
+        }
+        if (--s.pending > 0) return;
+        if (s.fd < 0) return finish(i); // unreadable: empty
+        if (!s.sniffed) s.buf.resize(prefix);
+        else s.buf.resize(s.stx.stx_size != 0 ? static_cast<size_t>(s.stx.stx_size) + 1 : 4096);
+        submit_read(i);
+    };
+
+    bool exhausted = false;
+    while (true) {
+        while (!exhausted && !free_slots.empty()) {
+            const size_t i = free_slots.back();
+            if (!next(slots[i].path, busy == 0)) {
+                exhausted = busy == 0;
+                break;
+            }
+            free_slots.pop_back();
+            start(i);
+        }
+        if (busy == 0) {
+            if (exhausted) return;
+            continue;
+        }
+        r.submit_and_wait();
+        r.reap(complete);
+    }
+}
+
+#else
+
+struct UringReader::Ring {};
+
+std::unique_ptr<UringReader> UringReader::open(unsigned) {
+    return nullptr;
+}
+
+UringReader::UringReader(std::unique_ptr<Ring> ring) : ring_(std::move(ring)) {}
+UringReader::~UringReader() = default;
+
+void UringReader::read_all(const NextFn&, const DoneFn&, size_t, const StopFn&) {}
+
+#endif
+
+} // namespace dryfinder
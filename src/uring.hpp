@@ -0,0 +1,44 @@
+// Batched whole-file reads through io_uring, used by Corpus::add_globs() to
+// keep many opens and reads in flight instead of blocking on one file at a
+// time. Linux only; elsewhere UringReader::open() returns null and callers
+// fall back to blocking reads.
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace dryfinder {
+
+class UringReader {
+public:
+    // A ring with up to `depth` files in flight, or null when io_uring or
+    // one of the operations it needs (openat, statx, read) is unavailable.
+    static std::unique_ptr<UringReader> open(unsigned depth);
+    ~UringReader();
+
+    UringReader(const UringReader&) = delete;
+    UringReader& operator=(const UringReader&) = delete;
+
+    // next(path, wait) supplies the next file. It may block only when
+    // `wait` is true (nothing is in flight); returning false then ends the
+    // run, otherwise it just means "nothing ready yet". done(path, text)
+    // receives each file in completion order and may move from both.
+    // Unreadable files arrive empty, like read_file_bytes().
+    // With `prefix` > 0, stop(first prefix bytes) is asked once they are
+    // in; a file it returns true for arrives with just that prefix (a
+    // binary file that will be skipped anyway).
+    using NextFn = std::function<bool(std::filesystem::path&, bool wait)>;
+    using DoneFn = std::function<void(std::filesystem::path&, std::string&)>;
+    using StopFn = std::function<bool(std::string_view prefix)>;
+    void read_all(const NextFn& next, const DoneFn& done, size_t prefix = 0, const StopFn& stop = {});
+
+private:
+    struct Ring;
+    explicit UringReader(std::unique_ptr<Ring> ring);
+    std::unique_ptr<Ring> ring_;
+};
+
+} // namespace dryfinder
@@ -0,0 +1,272 @@
+// Randomized differential test: generates small corpora with heavy
+// duplication and whitespace/identifier noise, runs dryfinder with random
+// option sets under every engine variant (and as shards merged afterwards)
+// and requires the YAML output to be byte-identical to --engine=reference;
+// `index build` + `query` must report the same hits for the queried file.
+//
+//   dryfinder-differential /path/to/dryfinder [--iterations N] [--seed S] [--keep]
+#include "corpus.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Every engine/variant that must reproduce the reference output exactly.
+static const std::vector<std::string> kVariants = {
+    "--engine=seed",
+    "--engine=seed --memory-limit=1", // seed groups merged from spill runs
+};
+
+// The sharded variant runs `shard I/kShards` for every I, then `merge`.
+static constexpr int kShards = 3;
+
+static std::string quote(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') out.push_back('\\');
+        out.push_back(c);
+    }
+    return out + "\"";
+}
+
+static std::string slurp(const fs::path& p) {
+    std::ifstream in(p, std::ios::binary);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+// The blocks of a YAML report with a hit in `file`: what `query file`
+// must print for the same corpus.
+static std::string blocks_with_hit(const std::string& yaml, const std::string& file) {
+    std::istringstream in(yaml);
+    std::string line, out, block;
+    std::getline(in, line);
+    out = line + "\n"; // "blocks:"
+    const std::string hit_line = "      - file: " + quote(file);
+    bool hit = false;
+    auto flush = [&] {
+        if (hit) out += block;
+        block.clear();
+        hit = false;
+    };
+    while (std::getline(in, line)) {
+        if (line.rfind("  - ", 0) == 0) flush();
+        block += line + "\n";
+        hit = hit || line == hit_line;
+    }
+    flush();
+    return out;
+}
+
+// The blocks of a YAML report as a sorted list of their hits, occurrences
+// and periods. `query` shows content from the queried file rather than from
+// a block's first hit, so `lines`, `bytes`, `content` and the block order
+// that depends on them are left out.
+static std::string block_shapes(const std::string& yaml) {
+    std::istringstream in(yaml);
+    std::string line;
+    std::vector<std::string> blocks;
+    bool content = false;
+    while (std::getline(in, line)) {
+        if (line.rfind("  - ", 0) == 0) {
+            blocks.emplace_back();
+            content = false;
+            continue;
+        }
+        if (line.rfind("    content:", 0) == 0) content = true;
+        if (blocks.empty() || content || line.rfind("    bytes:", 0) == 0) continue;
+        blocks.back() += line + "\n";
+    }
+    std::sort(blocks.begin(), blocks.end());
+    std::string out;
+    for (const auto& b : blocks) out += "  -\n" + b;
+    return out;
+}
+
+// The same periodic table in two files (alone in one, inside an array in
+// the other) must be one periodic block with a hit in each, under the
+// reference engine and every variant.
+static bool periodic_across_files(const std::string& exe, const fs::path& dir) {
+    fs::create_directories(dir);
+    std::string table;
+    for (int i = 0; i < 40; ++i) table += "    { " + std::to_string(i % 2) + ", 0 },\n";
+    std::ofstream(dir / "a.c") << table;
+    std::ofstream(dir / "b.c") << "static const int t[][2] = {\n" << table << "};\n";
+    std::vector<std::string> engines = { "--engine=reference" };
+    engines.insert(engines.end(), kVariants.begin(), kVariants.end());
+    bool ok = true;
+    for (const auto& engine : engines) {
+        const fs::path out = dir / "out.yaml";
+        const std::string cmd = "cd " + quote(dir.string()) + " && " + quote(exe) + " " + engine +
+                                " --min-lines 4 \"**.c\" > " + quote(out.string());
+        const std::string yaml = std::system(cmd.c_str()) == 0 ? slurp(out) : "";
+        size_t periodic = 0;
+        for (size_t at = yaml.find("    period:"); at != std::string::npos; at = yaml.find("    period:", at + 1))
+            ++periodic;
+        if (periodic != 1 || yaml.find("    occurrences: 2\n    period: 2\n    repeats: 20\n") == std::string::npos) {
+            std::cerr << "FAILED periodic table in two files: " << cmd << "\n";
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+static corpus::Spec random_spec(corpus::Rng& rng, uint64_t seed) {
+    corpus::Spec spec;
+    spec.seed = seed;
+    if (rng.below(8) == 0) {
+        spec.kind = corpus::Kind::IdenticalLines;
+        spec.lines = rng.range(1, 300);
+        spec.line_length = rng.range(1, 20);
+        spec.period = rng.range(1, 6);
+        spec.vendored = rng.below(2) ? 0.0 : 1.0; // the same table in two files
+        return spec;
+    }
+    spec.kind = corpus::Kind::Mixed;
+    spec.files = rng.range(1, 10);
+    spec.lines = rng.range(5, 150);
+    spec.line_length = rng.range(4, 30);
+    spec.dup_rate = 0.2 + 0.7 * rng.unit();
+    spec.block_min = rng.range(1, 4);
+    spec.block_max = spec.block_min + rng.range(0, 10);
+    spec.shared_blocks = rng.range(1, 8);
+    spec.noise = rng.below(2) ? 0.0 : 0.3 * rng.unit();
+    spec.vendored = rng.below(2) ? 0.0 : rng.unit();
+    spec.comments = rng.below(2) ? 0.0 : 0.3 * rng.unit();
+    spec.script = rng.below(2) ? 0.0 : rng.unit();
+    return spec;
+}
+
+static std::string random_options(corpus::Rng& rng) {
+    std::string opts;
+    if (rng.below(4) == 0) {
+        opts += " --granularity=tokens --min-tokens " + std::to_string(rng.range(1, 30));
+    } else {
+        opts += " --min-lines " + std::to_string(rng.range(1, 8));
+    }
+    if (rng.below(3) == 0) opts += " --ignore-indentation";
+    if (rng.below(3) == 0) opts += " --ignore-trailing-whitespace";
+    if (rng.below(4) == 0) opts += " --collapse-whitespace";
+    if (rng.below(4) == 0) opts += " --ignore-blank-lines";
+    if (rng.below(4) == 0) opts += " --normalize-identifiers";
+    if (rng.below(4) == 0) opts += " --max-gap " + std::to_string(rng.range(1, 3));
+    return opts;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " DRYFINDER [--iterations N] [--seed S] [--keep]\n";
+        return 2;
+    }
+    std::string exe = fs::absolute(argv[1]).string();
+    size_t iterations = 60;
+    uint64_t base_seed = 20240601;
+    bool keep = false;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--iterations" && i + 1 < argc) iterations = std::stoul(argv[++i]);
+        else if (arg == "--seed" && i + 1 < argc) base_seed = std::stoull(argv[++i]);
+        else if (arg == "--keep") keep = true;
+        else {
+            std::cerr << "unknown argument: " << arg << "\n";
+            return 2;
+        }
+    }
+
+    fs::path work = fs::temp_directory_path() /
+        ("dryfinder-diff-" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+    corpus::Rng rng(base_seed);
+    size_t failures = 0, compared = 0;
+
+    if (!periodic_across_files(exe, work / "periodic")) ++failures;
+
+    for (size_t it = 0; it < iterations; ++it) {
+        uint64_t seed = rng.next();
+        fs::path dir = work / ("case" + std::to_string(it));
+        corpus::generate(dir, random_spec(rng, seed));
+        std::string opts = random_options(rng);
+
+        // A dryfinder command line over the corpus with this case's options.
+        auto engine = [&](const std::string& args) {
+            return quote(exe) + " " + args + opts + " \"**.c\" \"**.py\"";
+        };
+        // The output, or nothing when the command exits nonzero or is killed:
+        // a failure is never treated as agreement.
+        auto run = [&](const std::string& command, const std::string& out_name) -> std::optional<std::string> {
+            fs::path out = work / out_name;
+            std::string cmd = "cd " + quote(dir.string()) + " && " + command + " > " + quote(out.string());
+            if (int status = std::system(cmd.c_str()); status != 0) {
+                std::cerr << "FAILED case " << it << " (corpus seed " << seed << ", status " << status
+                          << "): " << cmd << "\n";
+                return std::nullopt;
+            }
+            return slurp(out);
+        };
+
+        std::optional<std::string> expected = run(engine("--engine=reference"), "expected.yaml");
+        bool case_ok = true;
+        auto compare = [&](const std::string& label, const std::string& command,
+                           const std::optional<std::string>& want, bool shape_only) {
+            ++compared;
+            std::optional<std::string> got = run(command, "got.yaml");
+            if (got && shape_only) got = block_shapes(*got);
+            if (!want || !got) {
+                case_ok = false;
+                ++failures;
+            } else if (*got != *want) {
+                case_ok = false;
+                ++failures;
+                std::cerr << "MISMATCH case " << it << " (corpus seed " << seed << "): " << label << opts
+                          << "\n  corpus: " << dir.string() << "\n";
+            }
+        };
+        for (const auto& variant : kVariants) compare(variant, engine(variant), expected, false);
+
+        if (opts.find("--max-gap") == std::string::npos) { // shards do not support --max-gap
+            std::string sharded, partials;
+            for (int i = 0; i < kShards; ++i) {
+                std::string partial = quote((work / ("shard" + std::to_string(i))).string());
+                sharded += engine("shard --shard " + std::to_string(i) + "/" + std::to_string(kShards) +
+                                  " --output " + partial) + " && ";
+                partials += " " + partial;
+            }
+            compare("shard/merge", sharded + quote(exe) + " merge" + partials, expected, false);
+        }
+
+        // `index build` + `query FILE` reports the scan's blocks with a hit in
+        // FILE, spelled the way the scan spells it.
+        std::vector<std::string> sources;
+        for (const auto& e : fs::recursive_directory_iterator(dir)) {
+            const std::string ext = e.path().extension().string();
+            if (e.is_regular_file() && (ext == ".c" || ext == ".py"))
+                sources.push_back(e.path().lexically_relative(dir).generic_string());
+        }
+        std::sort(sources.begin(), sources.end());
+        if (!sources.empty() && opts.find("--max-gap") == std::string::npos) { // the index has no gaps
+            const std::string& file = sources[seed % sources.size()];
+            const std::string index = quote((work / "index").string());
+            std::optional<std::string> want;
+            if (expected) want = block_shapes(blocks_with_hit(*expected, "./" + file));
+            compare("index/query " + file,
+                    engine("index build --index " + index) + " && " + quote(exe) + " query --index " + index +
+                        " " + quote(file),
+                    want, true);
+        }
+        if (case_ok && !keep) fs::remove_all(dir);
+    }
+
+    std::cout << compared << " comparisons over " << iterations << " corpora, " << failures
+              << " mismatches or failed runs\n";
+    if (failures == 0 && !keep) fs::remove_all(work);
+    return failures == 0 ? 0 : 1;
+}